@@ -0,0 +1,299 @@
+/*
+ *  Copyright (C) 2025 UmeSoftware LLC
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+// Measures request latency against an HTTP server running in the same process, then
+// checks that concurrent calls all get their own answers.
+//
+//   mcp-bench [requests] [host] [event loops]
+//
+// The latency requests go over one kept-alive connection, one at a time, so the numbers
+// show how long a response waits in the transport rather than how much the server can
+// take at once. The check runs several connections on the same session, which the kernel
+// spreads among the event loops, and fails when any reply is missing or belongs to
+// another call, and that a progress token reused by a later call still gets its updates.
+
+#include "mcp-cpp/mcp_server.h"
+#include "mcp-cpp/mcp_http_server_transport.h"
+
+#include <curl/curl.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace Mcp;
+
+namespace {
+
+struct Client {
+	CURL* curl;
+	std::string url;
+	std::string session_id;
+	std::string body;
+};
+
+size_t cbWrite(char* data, size_t size, size_t count, void* user)
+{
+	static_cast<Client*>(user)->body.append(data, size * count);
+	return size * count;
+}
+
+size_t cbHeader(char* data, size_t size, size_t count, void* user)
+{
+	static const char name[] = "mcp-session-id:";
+	std::string line(data, size * count);
+
+	if (line.size() > sizeof(name) - 1 &&
+		std::equal(name, name + sizeof(name) - 1, line.begin(), [](char a, char b) { return a == tolower(b); }))
+	{
+		auto first = line.find_first_not_of(' ', sizeof(name) - 1);
+		auto last = line.find_last_not_of("\r\n");
+		static_cast<Client*>(user)->session_id = line.substr(first, last - first + 1);
+	}
+
+	return size * count;
+}
+
+bool Post(Client& client, const std::string& request)
+{
+	struct curl_slist* headers = nullptr;
+	headers = curl_slist_append(headers, "Content-Type: application/json");
+	headers = curl_slist_append(headers, "Accept: application/json, text/event-stream");
+
+	if (!client.session_id.empty())
+	{
+		headers = curl_slist_append(headers, ("mcp-session-id: " + client.session_id).c_str());
+	}
+
+	client.body.clear();
+
+	curl_easy_setopt(client.curl, CURLOPT_URL, client.url.c_str());
+	curl_easy_setopt(client.curl, CURLOPT_HTTPHEADER, headers);
+	curl_easy_setopt(client.curl, CURLOPT_POSTFIELDS, request.c_str());
+	curl_easy_setopt(client.curl, CURLOPT_POSTFIELDSIZE, (long)request.size());
+	curl_easy_setopt(client.curl, CURLOPT_WRITEFUNCTION, cbWrite);
+	curl_easy_setopt(client.curl, CURLOPT_WRITEDATA, &client);
+	curl_easy_setopt(client.curl, CURLOPT_HEADERFUNCTION, cbHeader);
+	curl_easy_setopt(client.curl, CURLOPT_HEADERDATA, &client);
+
+	CURLcode result = curl_easy_perform(client.curl);
+	curl_slist_free_all(headers);
+
+	long status = 0;
+	curl_easy_getinfo(client.curl, CURLINFO_RESPONSE_CODE, &status);
+
+	return result == CURLE_OK && status / 100 == 2;
+}
+
+void Measure(Client& client, const char* label, const std::string& request, int count)
+{
+	std::vector<double> samples;
+	samples.reserve(count);
+
+	for (int i = 0; i < count; i++)
+	{
+		auto start = std::chrono::steady_clock::now();
+
+		if (!Post(client, request) || client.body.find("\"result\"") == std::string::npos)
+		{
+			fprintf(stderr, "%s: request failed: %s\n", label, client.body.c_str());
+			exit(1);
+		}
+
+		samples.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+	}
+
+	std::sort(samples.begin(), samples.end());
+
+	printf(
+		"%-10s p50 %8.3f ms   p99 %8.3f ms   max %8.3f ms\n",
+		label,
+		samples[samples.size() / 2],
+		samples[samples.size() * 99 / 100],
+		samples.back()
+	);
+}
+
+bool Check(const std::string& url, const std::string& session_id, int connections, int count)
+{
+	std::atomic<int> failures(0);
+	std::vector<std::thread> threads;
+
+	for (int i = 0; i < connections; i++)
+	{
+		threads.emplace_back([&url, &session_id, &failures, i, count]()
+		{
+			Client client = { curl_easy_init(), url, session_id, "" };
+
+			for (int j = 0; j < count; j++)
+			{
+				// Ids must not collide within the session.
+				std::string id = std::to_string(i * count + j);
+				std::string value = std::to_string(i) + "-" + std::to_string(j);
+				std::string request = R"({"jsonrpc":"2.0","id":)" + id +
+					R"(,"method":"tools/call","params":{"name":"echo","arguments":{"value":")" + value + R"("}}})";
+
+				if (!Post(client, request) ||
+					client.body.find("\"text\":\"" + value + "\"") == std::string::npos ||
+					client.body.find("\"id\":" + id + ",") == std::string::npos)
+				{
+					fprintf(stderr, "check: %s got %s\n", value.c_str(), client.body.c_str());
+					failures++;
+				}
+			}
+
+			curl_easy_cleanup(client.curl);
+		});
+	}
+
+	for (auto& thread : threads)
+	{
+		thread.join();
+	}
+
+	printf("check      %d calls on %d connections, %d failed\n", connections * count, connections, failures.load());
+
+	return failures == 0;
+}
+
+bool CheckProgress(Client& client)
+{
+	int failures = 0;
+
+	// The second update of each call is held back by the progress interval and sent later.
+	for (int i = 0; i < 2; i++)
+	{
+		std::string request = R"({"jsonrpc":"2.0","id":)" + std::to_string(100 + i) +
+			R"(,"method":"tools/call","params":{"name":"progress","arguments":{},"_meta":{"progressToken":"p"}}})";
+
+		if (!Post(client, request) || client.body.find("\"progress\":2") == std::string::npos)
+		{
+			fprintf(stderr, "progress: call %d got %s\n", i, client.body.c_str());
+			failures++;
+		}
+	}
+
+	printf("progress   2 calls with one token, %d failed\n", failures);
+
+	return failures == 0;
+}
+
+}
+
+int main(int argc, char* argv[])
+{
+	int count = argc > 1 ? atoi(argv[1]) : 1000;
+	std::string host = argc > 2 ? argv[2] : "localhost:8001";
+	size_t event_loops = argc > 3 ? (size_t)atoi(argv[3]) : 1;
+
+	auto server = McpServer::CreateInstance("MCP Bench Server", "1.0.0.0");
+
+	server->AddTool(
+		{
+			.name = "echo",
+			.description = "Returns its argument.",
+			.input_schema = std::vector<McpProperty>
+				{
+					{ "value", MCP_PROPERTY_TYPE_STRING, "Value to return", true }
+				}
+		},
+		[&server](const McpRequest& request, const McpArguments& args)
+		{
+			server->SendToolResponse(request, CreateSimpleContent(std::string(args.Get("value"))));
+		}
+	);
+
+	server->AddTool(
+		{
+			.name = "sleep",
+			.description = "Sleeps 10 ms on the worker thread.",
+		},
+		[&server](const McpRequest& request, const McpArguments&)
+		{
+			std::this_thread::sleep_for(std::chrono::milliseconds(10));
+			server->SendToolResponse(request, CreateSimpleContent("slept"));
+		}
+	);
+
+	server->AddTool(
+		{
+			.name = "progress",
+			.description = "Reports progress twice in a row, then returns.",
+		},
+		[&server](const McpRequest& request, const McpArguments&)
+		{
+			server->SendProgress(request, 1, 2, "");
+			server->SendProgress(request, 2, 2, "");
+			std::this_thread::sleep_for(std::chrono::milliseconds(50));
+			server->SendToolResponse(request, CreateSimpleContent("done"));
+		}
+	);
+	server->SetProgressInterval(std::chrono::milliseconds(20));
+
+	auto transport = McpHttpServerTransport::CreateInstance(host, "/mcp");
+	transport->SetEventLoopCount(event_loops);
+
+	server->Run(std::move(transport));
+
+	curl_global_init(CURL_GLOBAL_DEFAULT);
+
+	Client client = { curl_easy_init(), "http://" + host + "/mcp", "", "" };
+
+	const std::string initialize = R"({"jsonrpc":"2.0","id":0,"method":"initialize","params":{"protocolVersion":"2025-06-18","capabilities":{},"clientInfo":{"name":"mcp-bench","version":"1.0.0.0"}}})";
+
+	bool connected = false;
+
+	for (int i = 0; i < 50 && !connected; i++)
+	{
+		connected = Post(client, initialize);
+
+		if (!connected)
+		{
+			std::this_thread::sleep_for(std::chrono::milliseconds(100));
+		}
+	}
+
+	if (!connected)
+	{
+		fprintf(stderr, "cannot connect to %s\n", client.url.c_str());
+		return 1;
+	}
+
+	Post(client, R"({"jsonrpc":"2.0","method":"notifications/initialized"})");
+
+	printf("%d requests each, one connection, %zu event loops\n", count, event_loops);
+
+	Measure(client, "ping", R"({"jsonrpc":"2.0","id":1,"method":"ping"})", count);
+	Measure(client, "echo", R"({"jsonrpc":"2.0","id":2,"method":"tools/call","params":{"name":"echo","arguments":{"value":"x"}}})", count);
+	Measure(client, "sleep", R"({"jsonrpc":"2.0","id":3,"method":"tools/call","params":{"name":"sleep","arguments":{}}})", std::max(1, count / 10));
+
+	bool is_correct = Check(client.url, client.session_id, 8, std::max(1, count / 10));
+	is_correct = CheckProgress(client) && is_correct;
+
+	curl_easy_cleanup(client.curl);
+	curl_global_cleanup();
+
+	server->Stop();
+
+	return is_correct ? 0 : 1;
+}
@@ -39,7 +39,7 @@ int main()
 			.name = "get_current_time",
 			.description = "Get the current time in UTC.",
 		},
-		[&server](const std::string& session_id, const std::map<std::string, std::string>& args)
+		[&server](const McpRequest& request, const McpArguments& args)
 		{
 			time_t now = time(NULL);
     		struct tm* tm_info = gmtime(&now);
@@ -58,16 +58,13 @@ int main()
 			);
 
 			server->SendToolResponse(
-				session_id,
-				"count_down",
+				request,
 				CreateSimpleContent(date_str)
 			);
 		}
 	);
 
-	std::unique_ptr<std::thread> count_down_worker;
-
-	server->AddTool(
+	server->AddAsyncTool(
 		{
 			.name = "count_down",
 			.description = "Counts down from a specified value.",
@@ -76,37 +73,25 @@ int main()
 					{ "value", MCP_PROPERTY_TYPE_STRING, "Start counting down from this value", true }
 				}
 		},
-		[&server, &count_down_worker](const std::string& session_id, const std::map<std::string, std::string>& args)
+		[&server](McpRequest request, McpArguments args) -> McpTask
 		{
-			if (count_down_worker && count_down_worker->joinable())
-			{
-				count_down_worker->join();
-			}
-
-			int start_value = atoi(args.at("value").c_str());
+			int start_value = atoi(std::string(args.Get("value")).c_str());
 
-			count_down_worker = std::make_unique<std::thread>([&server, session_id, start_value]
+			for (int i = start_value; i > 0 && !request.cancellation.IsCancelled(); i--)
 			{
-				for (int i = start_value; i > 0; i--)
-				{
-					auto params = R"(
-						{
-							"value": 0
-						}
-					)"_json;
-					params["value"] = i;
+				auto params = R"(
+					{
+						"value": 0
+					}
+				)"_json;
+				params["value"] = i;
 
-					server->SendToolNotification(session_id, "count_down", params);
+				server->SendToolNotification(request, "count_down", params);
 
-					std::this_thread::sleep_for(std::chrono::milliseconds(1000));
-				}
+				co_await McpDelay(std::chrono::milliseconds(1000));
+			}
 
-				server->SendToolResponse(
-					session_id,
-					"count_down",
-					CreateSimpleContent("finish!")
-				);
-			});
+			co_return CreateSimpleContent("finish!");
 		}
 	);
 
@@ -144,11 +129,6 @@ int main()
 	}
 #endif
 
-	if (count_down_worker && count_down_worker->joinable())
-	{
-		count_down_worker->join();
-	}
-
 	server->Stop();
 
 	return 0;
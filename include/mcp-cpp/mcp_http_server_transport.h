@@ -34,6 +34,16 @@ public:
 		const std::string& scopes_supported
 	) = 0;
 
+	// Restarts without downtime (POSIX only). A process opened with the same Unix socket path
+	// takes over the listening socket and the sessions of the one already running there. The
+	// old process then stops accepting, finishes its in-flight calls and ends its run loop.
+	virtual void SetHandoverPath(const std::string& path) = 0;
+
+	// Runs |count| event loops, each on its own thread with its own listening socket bound
+	// through SO_REUSEPORT, so the kernel spreads connections among them. 1 by default,
+	// 0 for one per core. Only one loop runs where SO_REUSEPORT is unavailable.
+	virtual void SetEventLoopCount(size_t count) = 0;
+
 	virtual ~McpHttpServerTransport() {}
 
 protected:
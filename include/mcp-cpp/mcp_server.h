@@ -18,9 +18,44 @@
 #pragma once
 
 #include "mcp_server_transport.h"
+#include "mcp_task.h"
 
 namespace Mcp {
 
+struct McpBatch;
+
+struct McpRequest {
+	std::string session_id;
+	unsigned long long stream_id;
+	std::string id;	// JSON-RPC id as raw JSON text (number or quoted string)
+	std::shared_ptr<McpBatch> batch;	// set when the request is part of a JSON-RPC batch
+	McpCancellationToken cancellation;
+	std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::time_point::max();	// when the call times out
+	std::string progress_token;	// params._meta.progressToken as raw JSON text, empty if the client sent none
+};
+
+typedef std::function <void(const McpRequest& request, const McpArguments& args)> McpToolCallback;
+
+// Coroutine tool handler. Arguments are taken by value because they must outlive suspension.
+typedef std::function <McpTask(McpRequest request, McpArguments args)> McpAsyncToolCallback;
+
+typedef std::function <void(const McpRequest& request, const nlohmann::json& params)> McpMethodCallback;
+
+typedef std::function <unsigned int(const std::string& session_id)> McpSessionWeightCallback;
+
+struct McpCacheStats {
+	size_t hits;
+	size_t misses;
+	size_t entries;
+	size_t memory_usage;
+};
+
+struct McpExecutorStats {
+	size_t thread_count;
+	size_t queue_depth;
+	size_t busy_threads;
+};
+
 class McpServer : public McpServerTransport::Handler
 {
 public:
@@ -28,19 +63,50 @@ public:
 
 	virtual ~McpServer() {}
 
-	virtual void AddTool(
-		const McpTool& tool,
-		std::function <void(const std::string& session_id, const std::map<std::string, std::string>& args)> callback
-		) = 0;
+	virtual void AddTool(const McpTool& tool, McpToolCallback callback) = 0;
+	virtual void AddAsyncTool(const McpTool& tool, McpAsyncToolCallback callback) = 0;
+
+	// Handles a JSON-RPC method (or "notifications/..." notification) not built into the server.
+	// Requests are answered with SendResponse or SendError. Must be called before Run.
+	virtual void RegisterMethod(const std::string& method, McpMethodCallback callback) = 0;
+
+	// Maximum number of tools per tools/list page. 0 returns every tool in one page.
+	virtual void SetToolsListPageSize(size_t page_size) = 0;
+
+	// Limits on requests in flight, over all sessions and per session. Requests over a limit
+	// are answered with -32000 "Server overloaded". 0 disables a limit.
+	virtual void SetRequestLimits(size_t max_requests, size_t max_session_requests) = 0;
+
+	// Number of threads running tool callbacks. Must be set before Run; 0 uses the number of cores.
+	virtual void SetToolThreadCount(size_t thread_count) = 0;
+	virtual McpExecutorStats GetExecutorStats() = 0;
+
+	// Tool threads are shared between sessions in proportion to their weight (1 by default).
+	// The callback is asked, outside any server lock, when a session starts using them and must return quickly.
+	virtual void SetSessionWeightCallback(McpSessionWeightCallback callback) = 0;
+
+	// Results of idempotent tools with a cache_ttl are reused for identical arguments, whichever session asks.
+	virtual void SetCacheMemoryLimit(size_t memory_limit) = 0;
+	virtual McpCacheStats GetCacheStats() = 0;
 
 	virtual bool Run(std::unique_ptr<McpServerTransport> transport) = 0;
 	virtual void Stop() = 0;
 	virtual bool IsRunning() = 0;
 
-	virtual void SendResponse(const std::string& session_id, const nlohmann::json& response) = 0;
-	virtual void SendError(const std::string& session_id, int code, const std::string& message) = 0;
-	virtual void SendToolNotification(const std::string& session_id, const std::string& method, const nlohmann::json& params) = 0;
-	virtual void SendToolResponse(const std::string& session_id, const std::string& method, std::vector<McpContent> contents) = 0;
+	virtual void SendResponse(const McpRequest& request, const nlohmann::json& result) = 0;
+	virtual void SendError(const McpRequest& request, int code, const std::string& message) = 0;
+	virtual void SendToolNotification(const McpRequest& request, const std::string& method, const nlohmann::json& params) = 0;
+
+	// Sends notifications/progress if the client asked for it. Updates arriving faster than the
+	// progress interval are coalesced so that only the latest one is sent. total <= 0 and an
+	// empty message are left out.
+	virtual void SendProgress(const McpRequest& request, double progress, double total, const std::string& message) = 0;
+	virtual void SetProgressInterval(std::chrono::milliseconds interval) = 0;
+
+	// Sends notifications/message on the request's stream if level is at or above the level the
+	// session chose with logging/setLevel (info until it does).
+	virtual void SendLogMessage(const McpRequest& request, McpLogLevel level, const std::string& logger, const nlohmann::json& data) = 0;
+	virtual void SendToolResponse(const McpRequest& request, std::vector<McpContent> contents) = 0;
 
 protected:
 	McpServer() {}
@@ -23,12 +23,19 @@ namespace Mcp {
 
 class McpServerTransport {
 public:
+	// A transport may call the handler from several threads at once. The HTTP transport
+	// calls OnRecv and CanAccept from every event loop, and OnClose from the loop that saw
+	// the session end; sessions that expire are closed from the first loop only.
 	class Handler {
 	public:
 		virtual ~Handler() {}
 
 		virtual void OnClose(const std::string& session_id) = 0;
-		virtual bool OnRecv(const std::string& session_id, const std::string& request_str) = 0;
+		virtual bool OnRecv(const std::string& session_id, unsigned long long stream_id, std::string request_str) = 0;
+
+		// Lets a transport turn a request away before reading it. An empty session id checks only global limits,
+		// and an empty method asks only whether the queues have room.
+		virtual bool CanAccept(const std::string& /* session_id */, const std::string& /* method */) { return true; }
 	};
 
 	virtual ~McpServerTransport();
@@ -40,14 +47,18 @@ protected:
 
 private:
 	bool Open(Handler* handler);
+	void Stop();	// no handler calls after this, though responses may still be sent until Close
 	void Close();
 	bool ProcRequest();
-	void SendResponse(const std::string& session_id, const std::string& response_str, bool is_finish = true);
+	void SendResponse(const std::string& session_id, unsigned long long stream_id, const std::string& response_str, bool is_finish = true);
+	void CancelResponse(const std::string& session_id, unsigned long long stream_id);
 
 	virtual bool OnOpen() { return true; };
+	virtual void OnStop() {};
 	virtual void OnClose() {};
 	virtual bool OnProcRequest() { return true; };
-	virtual void OnSendResponse(const std::string& session_id, const std::string& response_str, bool is_finish) {};
+	virtual void OnSendResponse(const std::string& /* session_id */, unsigned long long /* stream_id */, const std::string& /* response_str */, bool /* is_finish */) {};
+	virtual void OnCancelResponse(const std::string& /* session_id */, unsigned long long /* stream_id */) {};
 
 	friend class McpServerImpl;
 };
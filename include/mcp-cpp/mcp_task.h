@@ -0,0 +1,158 @@
+/*
+ *  Copyright (C) 2025 UmeSoftware LLC
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "mcp_type.h"
+
+#include <chrono>
+#include <coroutine>
+#include <exception>
+#include <optional>
+#include <utility>
+
+namespace Mcp {
+
+class McpTask {
+public:
+	struct promise_type {
+		std::function <void(std::function<void()> resume, std::chrono::milliseconds delay)> post;
+		std::function <void(std::vector<McpContent> contents)> on_result;
+		std::function <void(std::exception_ptr error)> on_error;
+
+		McpTask get_return_object() { return McpTask(std::coroutine_handle<promise_type>::from_promise(*this)); }
+		std::suspend_always initial_suspend() noexcept { return {}; }
+		std::suspend_never final_suspend() noexcept { return {}; }
+		void return_value(std::vector<McpContent> contents) { on_result(std::move(contents)); }
+		void unhandled_exception() { on_error(std::current_exception()); }
+	};
+
+	McpTask(McpTask&& other) noexcept : m_handle(other.m_handle) { other.m_handle = nullptr; }
+	McpTask(const McpTask&) = delete;
+	McpTask& operator=(const McpTask&) = delete;
+
+	~McpTask()
+	{
+		if (m_handle)
+		{
+			m_handle.destroy();
+		}
+	}
+
+	// Runs the coroutine on the calling thread until its first suspension.
+	// From then on the coroutine frame owns itself and is freed when it completes.
+	void Start(
+		std::function <void(std::function<void()> resume, std::chrono::milliseconds delay)> post,
+		std::function <void(std::vector<McpContent> contents)> on_result,
+		std::function <void(std::exception_ptr error)> on_error
+	)
+	{
+		std::coroutine_handle<promise_type> handle = m_handle;
+		m_handle = nullptr;
+
+		handle.promise().post = std::move(post);
+		handle.promise().on_result = std::move(on_result);
+		handle.promise().on_error = std::move(on_error);
+		handle.resume();
+	}
+
+private:
+	std::coroutine_handle<promise_type> m_handle;
+
+	explicit McpTask(std::coroutine_handle<promise_type> handle) : m_handle(handle) {}
+};
+
+// Resumes a suspended tool once. When it is dropped without running, for example because
+// the server stopped with the resume still pending, the coroutine frame is destroyed
+// instead of leaked.
+class McpResumer {
+public:
+	explicit McpResumer(std::coroutine_handle<McpTask::promise_type> handle) : m_state(std::make_shared<State>(handle)) {}
+
+	void operator()() const { std::exchange(m_state->handle, nullptr).resume(); }
+
+private:
+	struct State {
+		explicit State(std::coroutine_handle<McpTask::promise_type> handle_) : handle(handle_) {}
+		~State()
+		{
+			if (handle)
+			{
+				handle.destroy();
+			}
+		}
+
+		std::coroutine_handle<McpTask::promise_type> handle;
+	};
+	std::shared_ptr<State> m_state;
+};
+
+// Suspends the tool and resumes it on the server's executor once the callback-based
+// operation passed to the constructor calls its completion handler.
+template <typename T>
+class McpAwait {
+public:
+	explicit McpAwait(std::function <void(std::function<void(T value)> complete)> start)
+		: m_start(std::move(start))
+		, m_value(std::make_shared<std::optional<T>>())
+	{
+	}
+
+	bool await_ready() { return false; }
+
+	void await_suspend(std::coroutine_handle<McpTask::promise_type> handle)
+	{
+		// The completion handler may resume the coroutine before start() returns,
+		// so nothing in the awaiter is touched after the call.
+		auto start = std::move(m_start);
+		auto value = m_value;
+		auto post = handle.promise().post;
+
+		start([value, post, resumer = McpResumer(handle)](T result)
+		{
+			*value = std::move(result);
+			post(resumer, std::chrono::milliseconds(0));
+		});
+	}
+
+	T await_resume() { return std::move(**m_value); }
+
+private:
+	std::function <void(std::function<void(T value)> complete)> m_start;
+	std::shared_ptr<std::optional<T>> m_value;
+};
+
+// Suspends the tool for the given time without holding an executor thread.
+class McpDelay {
+public:
+	explicit McpDelay(std::chrono::milliseconds delay) : m_delay(delay) {}
+
+	bool await_ready() { return m_delay.count() <= 0; }
+
+	void await_suspend(std::coroutine_handle<McpTask::promise_type> handle)
+	{
+		auto post = handle.promise().post;
+		post(McpResumer(handle), m_delay);
+	}
+
+	void await_resume() {}
+
+private:
+	std::chrono::milliseconds m_delay;
+};
+
+}
@@ -19,6 +19,9 @@
 
 #include "nlohmann/json.hpp"
 
+#include <atomic>
+#include <chrono>
+#include <cstdint>
 #include <condition_variable>
 #include <functional>
 #include <map>
@@ -28,6 +31,7 @@
 #include <queue>
 #include <set>
 #include <string>
+#include <string_view>
 #include <thread>
 #include <vector>
 
@@ -38,17 +42,41 @@ enum McpPropertyType {
 	MCP_PROPERTY_TYPE_NUMBER = 0,
 	MCP_PROPERTY_TYPE_TEXT,
 	MCP_PROPERTY_TYPE_STRING,
-	MCP_PROPERTY_TYPE_OBJECT
+	MCP_PROPERTY_TYPE_OBJECT,
+	MCP_PROPERTY_TYPE_INTEGER,
+	MCP_PROPERTY_TYPE_BOOLEAN
 };
 
 std::string McpPropertyTypeToString(McpPropertyType type);
 McpPropertyType StringToMcpPropertyType(const std::string& type);
 
+// Syslog severities used by logging/setLevel and notifications/message.
+enum McpLogLevel {
+	MCP_LOG_LEVEL_UNKNOWN = -1,
+	MCP_LOG_LEVEL_DEBUG = 0,
+	MCP_LOG_LEVEL_INFO,
+	MCP_LOG_LEVEL_NOTICE,
+	MCP_LOG_LEVEL_WARNING,
+	MCP_LOG_LEVEL_ERROR,
+	MCP_LOG_LEVEL_CRITICAL,
+	MCP_LOG_LEVEL_ALERT,
+	MCP_LOG_LEVEL_EMERGENCY
+};
+
+std::string McpLogLevelToString(McpLogLevel level);
+McpLogLevel StringToMcpLogLevel(std::string_view level);
+
+// Minimum level of the library's own diagnostics written to stderr. Defaults to warning.
+void SetMcpLogLevel(McpLogLevel level);
+
 struct McpProperty {
 	std::string name;
 	McpPropertyType type;
 	std::string description;
 	bool required;
+	std::vector<std::string> enum_values;	// allowed values, numbers written as JSON numbers
+	std::optional<double> minimum;	// inclusive bounds for number and integer properties
+	std::optional<double> maximum;
 };
 
 struct McpTool {
@@ -56,6 +84,76 @@ struct McpTool {
 	std::string description;
 	std::vector<McpProperty> input_schema;
 	std::vector<McpProperty> output_schema;
+	std::chrono::milliseconds timeout = std::chrono::milliseconds(0);	// server side limit per call, 0 for none
+	// Identical calls to an idempotent tool are coalesced, and with a cache_ttl their result reused,
+	// across all sessions without regard to who is calling.
+	bool idempotent = false;	// the same arguments always give the same result
+	std::chrono::milliseconds cache_ttl = std::chrono::milliseconds(0);	// how long an idempotent result is reused, ignored unless idempotent
+};
+
+// Arguments of a tools/call request. Names and values are views into the received
+// request, which every copy keeps alive.
+class McpArguments
+{
+public:
+	McpArguments();
+
+	bool Has(std::string_view name) const;
+
+	// String values are returned unescaped; other values as their JSON text. Empty if absent.
+	std::string_view Get(std::string_view name) const;
+
+	// Values converted when the call was validated. |default_value| if absent or not convertible.
+	int64_t GetInt64(std::string_view name, int64_t default_value = 0) const;
+	double GetDouble(std::string_view name, double default_value = 0) const;
+	bool GetBool(std::string_view name, bool default_value = false) const;
+
+	size_t Size() const;
+
+private:
+	struct McpArgument {
+		std::string_view name;
+		std::string_view value;
+		McpPropertyType type;	// kind of the value; OBJECT also covers arrays, UNKNOWN is null
+		int64_t int_value;
+		double double_value;
+		bool bool_value;
+	};
+	std::vector<McpArgument> m_arguments;
+	std::shared_ptr<const std::string> m_buffer;
+	std::shared_ptr<const std::string> m_storage;	// unescaped names and values
+
+	const McpArgument* Find(std::string_view name) const;
+
+	friend class McpServerImpl;
+	friend class McpInputValidator;
+};
+
+// Set when the client cancels a request. Tools either poll IsCancelled or
+// register a callback with OnCancel.
+class McpCancellationToken
+{
+public:
+	McpCancellationToken();	// never cancelled
+	static McpCancellationToken Create();
+
+	bool IsCancelled() const;
+	// Cancels every copy of the token and runs the OnCancel callbacks, once.
+	void Cancel() const;
+
+	// Runs |callback| once on cancellation, or right away if already cancelled.
+	void OnCancel(std::function<void()> callback) const;
+
+	// Whether both are copies of the same token, that is belong to the same request.
+	bool operator==(const McpCancellationToken& other) const { return m_state == other.m_state; }
+
+private:
+	struct McpCancellationState {
+		std::atomic<bool> is_cancelled;
+		std::mutex mutex;
+		std::vector<std::function<void()>> callbacks;
+	};
+	std::shared_ptr<McpCancellationState> m_state;
 };
 
 struct McpPropertyValue {
@@ -15,7 +15,7 @@
  *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
  */
 
-#pragma
+#pragma once
 
 #include "mcp-cpp/mcp_type.h"
 
@@ -0,0 +1,303 @@
+/*
+ *  Copyright (C) 2025 UmeSoftware LLC
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "mcp_executor.h"
+
+namespace Mcp {
+
+static thread_local McpExecutor* s_current_executor = nullptr;
+static thread_local size_t s_current_worker = 0;
+
+McpExecutor::McpExecutor()
+	: m_next_worker(0)
+	, m_queue_depth(0)
+	, m_busy_threads(0)
+	, m_is_running(false)
+	, m_next_timer_id(0)
+{
+}
+
+McpExecutor::~McpExecutor()
+{
+	Stop();
+}
+
+void McpExecutor::Start(size_t thread_count)
+{
+	if (thread_count == 0)
+	{
+		thread_count = 1;
+	}
+
+	m_is_running = true;
+
+	for (size_t i = 0; i < thread_count; i++)
+	{
+		m_workers.emplace_back(std::make_unique<Worker>());
+	}
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+
+		for (size_t i = 0; i < m_pending_tasks.size(); i++)
+		{
+			m_workers[i % thread_count]->tasks.emplace_back(std::move(m_pending_tasks[i]));
+		}
+		m_queue_depth += m_pending_tasks.size();
+		m_pending_tasks.clear();
+	}
+	for (size_t i = 0; i < thread_count; i++)
+	{
+		m_threads.emplace_back([this, i] { Run(i); });
+	}
+
+	m_timer_thread = std::thread([this] { RunTimer(); });
+}
+
+void McpExecutor::Stop()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		if (!m_is_running)
+		{
+			return;
+		}
+		m_is_running = false;
+	}
+	m_cv.notify_all();
+
+	// Pending timers are dropped without running. They are destroyed outside the lock,
+	// since dropping a coroutine resume destroys the coroutine frame.
+	TimerMap timers;
+	{
+		std::lock_guard<std::mutex> lock(m_timer_mutex);
+		timers.swap(m_timers);
+		m_timer_index.clear();
+	}
+	m_timer_cv.notify_all();
+	m_timer_thread.join();
+	timers.clear();
+
+	for (auto it = m_threads.begin(); it != m_threads.end(); it++)
+	{
+		it->join();
+	}
+	m_threads.clear();
+	m_workers.clear();
+}
+
+void McpExecutor::Post(std::function<void()> task)
+{
+	if (m_workers.empty())
+	{
+		// Not started; the task waits for Start instead of running on the caller,
+		// which may hold a lock that the task needs.
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_pending_tasks.emplace_back(std::move(task));
+		return;
+	}
+
+	// Tasks posted from a worker stay on its own queue; others are spread round-robin.
+	size_t index;
+	if (s_current_executor == this)
+	{
+		index = s_current_worker;
+	}
+	else
+	{
+		index = m_next_worker++ % m_workers.size();
+	}
+
+	{
+		// Counted under the worker's lock, so a thief cannot take the task before it is counted.
+		Worker& worker = *m_workers[index];
+		std::lock_guard<std::mutex> lock(worker.mutex);
+		worker.tasks.emplace_back(std::move(task));
+		m_queue_depth++;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+	}
+	m_cv.notify_one();
+}
+
+void McpExecutor::PostAfter(std::chrono::milliseconds delay, std::function<void()> task)
+{
+	if (delay.count() <= 0)
+	{
+		Post(std::move(task));
+		return;
+	}
+
+	AddTimer(delay, std::move(task), false);
+}
+
+unsigned long long McpExecutor::RunAfter(std::chrono::milliseconds delay, std::function<void()> task)
+{
+	return AddTimer(delay, std::move(task), true);
+}
+
+void McpExecutor::CancelTimer(unsigned long long timer_id)
+{
+	// Destroyed outside the lock, like the timers dropped by Stop.
+	std::function<void()> task;
+	{
+		std::lock_guard<std::mutex> lock(m_timer_mutex);
+
+		auto it = m_timer_index.find(timer_id);
+		if (it == m_timer_index.end())
+		{
+			return;
+		}
+		task = std::move(it->second->second.task);
+		m_timers.erase(it->second);
+		m_timer_index.erase(it);
+	}
+}
+
+unsigned long long McpExecutor::AddTimer(std::chrono::milliseconds delay, std::function<void()> task, bool is_inline)
+{
+	Timer timer;
+	timer.task = std::move(task);
+	timer.is_inline = is_inline;
+
+	unsigned long long timer_id;
+	{
+		std::lock_guard<std::mutex> lock(m_timer_mutex);
+		timer_id = ++m_next_timer_id;
+		timer.id = timer_id;
+		m_timer_index.emplace(timer_id, m_timers.emplace(std::chrono::steady_clock::now() + delay, std::move(timer)));
+	}
+	m_timer_cv.notify_one();
+
+	return timer_id;
+}
+
+size_t McpExecutor::GetThreadCount()
+{
+	return m_threads.size();
+}
+
+size_t McpExecutor::GetQueueDepth()
+{
+	return m_queue_depth;
+}
+
+size_t McpExecutor::GetBusyThreadCount()
+{
+	return m_busy_threads;
+}
+
+void McpExecutor::Run(size_t index)
+{
+	s_current_executor = this;
+	s_current_worker = index;
+
+	while (true)
+	{
+		std::function<void()> task;
+		if (PopTask(index, task))
+		{
+			m_busy_threads++;
+			task();
+			m_busy_threads--;
+			continue;
+		}
+
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_cv.wait(lock, [this] { return m_queue_depth > 0 || !m_is_running; });
+		if (!m_is_running && m_queue_depth == 0)
+		{
+			break;
+		}
+	}
+
+	s_current_executor = nullptr;
+}
+
+void McpExecutor::RunTimer()
+{
+	std::unique_lock<std::mutex> lock(m_timer_mutex);
+
+	while (true)
+	{
+		{
+			std::lock_guard<std::mutex> lock2(m_mutex);
+			if (!m_is_running)
+			{
+				break;
+			}
+		}
+
+		if (m_timers.empty())
+		{
+			m_timer_cv.wait(lock);
+			continue;
+		}
+
+		auto due = m_timers.begin()->first;
+		if (m_timer_cv.wait_until(lock, due) == std::cv_status::no_timeout)
+		{
+			continue;
+		}
+
+		std::vector<Timer> due_timers;
+		auto it = m_timers.begin();
+		while (it != m_timers.end() && it->first <= std::chrono::steady_clock::now())
+		{
+			m_timer_index.erase(it->second.id);
+			due_timers.emplace_back(std::move(it->second));
+			it = m_timers.erase(it);
+		}
+
+		lock.unlock();
+		for (auto it2 = due_timers.begin(); it2 != due_timers.end(); it2++)
+		{
+			if (it2->is_inline)
+			{
+				it2->task();
+			}
+			else
+			{
+				Post(std::move(it2->task));
+			}
+		}
+		lock.lock();
+	}
+}
+
+bool McpExecutor::PopTask(size_t index, std::function<void()>& task)
+{
+	// Own queue first, then steal from the others in order.
+	for (size_t i = 0; i < m_workers.size(); i++)
+	{
+		Worker& worker = *m_workers[(index + i) % m_workers.size()];
+
+		std::lock_guard<std::mutex> lock(worker.mutex);
+		if (!worker.tasks.empty())
+		{
+			task = std::move(worker.tasks.front());
+			worker.tasks.pop_front();
+			m_queue_depth--;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+}
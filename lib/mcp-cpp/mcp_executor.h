@@ -0,0 +1,87 @@
+/*
+ *  Copyright (C) 2025 UmeSoftware LLC
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "mcp-cpp/mcp_type.h"
+
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <unordered_map>
+
+namespace Mcp {
+
+class McpExecutor
+{
+public:
+	McpExecutor();
+	~McpExecutor();
+
+	void Start(size_t thread_count);
+	void Stop();
+
+	void Post(std::function<void()> task);
+	void PostAfter(std::chrono::milliseconds delay, std::function<void()> task);
+
+	// Runs |task| on the timer thread itself, so it fires even when every worker is busy.
+	// The task must be short and must not block. Returns an id for CancelTimer.
+	unsigned long long RunAfter(std::chrono::milliseconds delay, std::function<void()> task);
+	// Drops a timer that has not fired yet; does nothing once it has.
+	void CancelTimer(unsigned long long timer_id);
+
+	size_t GetThreadCount();
+	size_t GetQueueDepth();
+	size_t GetBusyThreadCount();
+
+private:
+	struct Worker {
+		std::deque<std::function<void()>> tasks;
+		std::mutex mutex;
+	};
+	std::vector<std::unique_ptr<Worker>> m_workers;
+	std::vector<std::thread> m_threads;
+	std::deque<std::function<void()>> m_pending_tasks;	// posted before Start
+
+	std::atomic<size_t> m_next_worker;
+	std::atomic<size_t> m_queue_depth;
+	std::atomic<size_t> m_busy_threads;
+
+	std::mutex m_mutex;
+	std::condition_variable m_cv;
+	bool m_is_running;
+
+	struct Timer {
+		unsigned long long id;
+		std::function<void()> task;
+		bool is_inline;
+	};
+	typedef std::multimap<std::chrono::steady_clock::time_point, Timer> TimerMap;
+	TimerMap m_timers;
+	std::unordered_map<unsigned long long, TimerMap::iterator> m_timer_index;	// by id
+	unsigned long long m_next_timer_id;
+	std::thread m_timer_thread;
+	std::mutex m_timer_mutex;
+	std::condition_variable m_timer_cv;
+
+	void Run(size_t index);
+	void RunTimer();
+	unsigned long long AddTimer(std::chrono::milliseconds delay, std::function<void()> task, bool is_inline);
+	bool PopTask(size_t index, std::function<void()>& task);
+};
+
+}
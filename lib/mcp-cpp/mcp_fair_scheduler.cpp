@@ -0,0 +1,198 @@
+/*
+ *  Copyright (C) 2025 UmeSoftware LLC
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "mcp_fair_scheduler.h"
+
+#include <algorithm>
+#include <tuple>
+
+namespace Mcp {
+
+static const long long QUANTUM = 10000;
+static const long long MAX_DEBT = 100 * QUANTUM;
+static const std::chrono::seconds DEBT_DECAY(10);	// an idle key's debt is forgiven over this time
+
+McpFairScheduler::McpFairScheduler(McpExecutor& executor)
+	: m_executor(executor)
+	, m_slot_count(1)
+	, m_running(0)
+	, m_queue_depth(0)
+{
+}
+
+void McpFairScheduler::SetSlotCount(size_t slot_count)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	m_slot_count = slot_count > 0 ? slot_count : 1;
+}
+
+void McpFairScheduler::SetWeightCallback(std::function<unsigned int(const std::string& key)> weight_callback)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	m_weight_callback = weight_callback;
+}
+
+void McpFairScheduler::Post(const std::string& key, std::function<void()> task)
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+
+	auto now = std::chrono::steady_clock::now();
+	Sweep(now);
+
+	auto it = m_flows.find(key);
+	if (it == m_flows.end())
+	{
+		// The callback may take locks of its own, so it must not run under m_mutex.
+		auto weight_callback = m_weight_callback;
+		lock.unlock();
+		unsigned int weight = weight_callback ? weight_callback(key) : 1;
+		lock.lock();
+
+		bool is_new;
+		std::tie(it, is_new) = m_flows.try_emplace(key);
+		if (is_new)
+		{
+			it->second.weight = weight > 0 ? weight : 1;
+			it->second.average_cost = QUANTUM;
+		}
+	}
+
+	Flow& flow = it->second;
+	if (!flow.is_active && flow.running == 0 && flow.deficit < 0)
+	{
+		double decayed = std::chrono::duration<double>(now - flow.idle_since) / DEBT_DECAY;
+		flow.deficit = decayed < 1 ? (long long)(flow.deficit * (1 - decayed)) : 0;
+	}
+
+	flow.tasks.emplace_back(std::move(task));
+	if (!flow.is_active)
+	{
+		flow.is_active = true;
+		m_active_keys.emplace_back(key);
+	}
+	m_queue_depth++;
+
+	Dispatch();
+}
+
+size_t McpFairScheduler::GetQueueDepth()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	return m_queue_depth;
+}
+
+// Must be called with m_mutex held.
+void McpFairScheduler::Dispatch()
+{
+	while (m_running < m_slot_count && !m_active_keys.empty())
+	{
+		std::string key = m_active_keys.front();
+		Flow& flow = m_flows[key];
+
+		if (flow.deficit <= 0)
+		{
+			// Out of credit for this round; top up and move to the back.
+			flow.deficit += QUANTUM * flow.weight;
+			m_active_keys.pop_front();
+			m_active_keys.emplace_back(key);
+			continue;
+		}
+
+		std::function<void()> task = std::move(flow.tasks.front());
+		flow.tasks.pop_front();
+		m_queue_depth--;
+
+		long long estimate = flow.average_cost;
+		flow.deficit = std::max(flow.deficit - estimate, -MAX_DEBT * flow.weight);
+		flow.running++;
+		m_running++;
+
+		if (flow.tasks.empty())
+		{
+			flow.is_active = false;
+			m_active_keys.pop_front();
+		}
+
+		m_executor.Post([this, key, estimate, task = std::move(task)]
+		{
+			auto start = std::chrono::steady_clock::now();
+			task();
+			auto cost = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+
+			Finish(key, estimate, cost);
+		});
+	}
+}
+
+void McpFairScheduler::Finish(const std::string& key, long long estimate, long long cost)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	m_running--;
+
+	auto it = m_flows.find(key);
+	if (it != m_flows.end())
+	{
+		Flow& flow = it->second;
+		flow.running--;
+		flow.average_cost = (flow.average_cost * 7 + cost) / 8;
+
+		flow.deficit = std::max(flow.deficit - (cost - estimate), -MAX_DEBT * flow.weight);
+
+		if (!flow.is_active && flow.running == 0)
+		{
+			// Unused credit is not saved up, but debt is kept until it has decayed.
+			if (flow.deficit >= 0)
+			{
+				m_flows.erase(it);
+			}
+			else
+			{
+				flow.idle_since = std::chrono::steady_clock::now();
+			}
+		}
+	}
+
+	Dispatch();
+}
+
+// Must be called with m_mutex held. Forgets keys whose debt has fully decayed.
+void McpFairScheduler::Sweep(std::chrono::steady_clock::time_point now)
+{
+	if (now - m_swept_at < DEBT_DECAY)
+	{
+		return;
+	}
+	m_swept_at = now;
+
+	for (auto it = m_flows.begin(); it != m_flows.end();)
+	{
+		if (!it->second.is_active && it->second.running == 0 && now - it->second.idle_since >= DEBT_DECAY)
+		{
+			it = m_flows.erase(it);
+		}
+		else
+		{
+			it++;
+		}
+	}
+}
+
+}
@@ -0,0 +1,71 @@
+/*
+ *  Copyright (C) 2025 UmeSoftware LLC
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "mcp_executor.h"
+
+#include <unordered_map>
+
+namespace Mcp {
+
+// Deficit round robin in front of the executor. Each key (a session) gets a share of
+// the executor threads in proportion to its weight, charged by measured run time.
+// A key that goes idle in debt keeps it for a while, so that pausing between
+// bursts does not wipe out what it owes.
+class McpFairScheduler
+{
+public:
+	McpFairScheduler(McpExecutor& executor);
+
+	// Number of tasks handed to the executor at once; usually its thread count.
+	void SetSlotCount(size_t slot_count);
+	// Called once per key, outside the scheduler's lock, when the key is first seen or
+	// has been forgotten.
+	void SetWeightCallback(std::function<unsigned int(const std::string& key)> weight_callback);
+
+	void Post(const std::string& key, std::function<void()> task);
+
+	size_t GetQueueDepth();
+
+private:
+	McpExecutor& m_executor;
+	size_t m_slot_count;
+	std::function<unsigned int(const std::string& key)> m_weight_callback;
+
+	struct Flow {
+		std::deque<std::function<void()>> tasks;
+		unsigned int weight = 1;
+		long long deficit = 0;	// microseconds
+		long long average_cost = 0;	// microseconds, charged up front and corrected on completion
+		size_t running = 0;
+		bool is_active = false;
+		std::chrono::steady_clock::time_point idle_since;	// when the last task finished
+	};
+	std::unordered_map<std::string, Flow> m_flows;
+	std::deque<std::string> m_active_keys;
+	size_t m_running;
+	size_t m_queue_depth;
+	std::chrono::steady_clock::time_point m_swept_at;
+	std::mutex m_mutex;
+
+	void Dispatch();
+	void Sweep(std::chrono::steady_clock::time_point now);
+	void Finish(const std::string& key, long long estimate, long long cost);
+};
+
+}
@@ -19,13 +19,18 @@
 #include "platform/platform.h"
 
 #include "mongoose.c"
+#include "mongoose_ext.h"
 
 #include "mcp_http_server_transport_impl.h"
 #include "mcp_common.h"
+#include "mcp_logger.h"
 #include "jwt-cpp/jwt.h"
 
 namespace Mcp {
 
+static const size_t MAX_QUEUED_NOTIFICATIONS = 1024;
+static const std::chrono::milliseconds TLS_RELOAD_INTERVAL(1000);	// between checks of the certificate files
+
 std::unique_ptr<McpHttpServerTransport> McpHttpServerTransport::CreateInstance(const std::string& host, const std::string& entry_point, unsigned long long session_timeout)
 {
 	return  std::make_unique<McpHttpServerTransportImpl>(host, entry_point, session_timeout);
@@ -38,7 +43,12 @@ McpHttpServerTransportImpl::McpHttpServerTransportImpl(const std::string& host,
 	, m_entry_point(entry_point)
 	, m_session_timeout(session_timeout)
 	, m_use_tls(false)
+	, m_is_tls_stopping(false)
 	, m_use_authorization(false)
+	, m_handover_fd(-1)
+	, m_is_draining(false)
+	, m_event_loop_count(1)
+	, m_is_running(false)
 {
 }
 
@@ -76,26 +86,278 @@ void McpHttpServerTransportImpl::SetAuthorization(const std::string& authorizati
 	}
 }
 
+void McpHttpServerTransportImpl::SetHandoverPath(const std::string& path)
+{
+	m_handover_path = path;
+}
+
+void McpHttpServerTransportImpl::SetEventLoopCount(size_t count)
+{
+	m_event_loop_count = count;
+}
+
 bool McpHttpServerTransportImpl::OnOpen()
 {
 	UpdateUrl();
 
-	mg_mgr_init(&m_mgr);
+#if MG_TLS == MG_TLS_OPENSSL
+	if (m_use_tls)
+	{
+		if (!LoadTlsContext())
+		{
+			MCP_LOG_ERROR("cannot load the certificate %s with the key %s", m_cert_file.c_str(), m_key_file.c_str());
+			return false;
+		}
+
+		m_is_tls_stopping = false;
+		m_tls_thread = std::make_unique<std::thread>(&McpHttpServerTransportImpl::ProcTlsReload, this);
+	}
+#endif
+
+	size_t shard_count = m_event_loop_count;
+	if (shard_count == 0)
+	{
+		shard_count = std::max(std::thread::hardware_concurrency(), 1u);
+	}
+#ifndef SO_REUSEPORT
+	if (shard_count > 1)
+	{
+		MCP_LOG_WARNING("SO_REUSEPORT is not available, running one event loop");
+		shard_count = 1;
+	}
+#endif
+
+	m_is_draining = false;
+	m_is_running = true;
+
+	for (size_t i = 0; i < shard_count; i++)
+	{
+		auto shard = std::make_unique<Shard>();
+		shard->transport = this;
+		shard->index = i;
+		shard->is_drained = false;
+		shard->wakeup_socket = MG_INVALID_SOCKET;
+		mg_mgr_init(&shard->mgr);
+
+		if (!OpenWakeup(*shard))
+		{
+			MCP_LOG_WARNING("cannot create the wakeup pipe, responses wait for the next poll");
+		}
+		m_shards.emplace_back(std::move(shard));
+	}
+
+	mg_timer_init(&m_shards[0]->mgr.timers, &m_timer, m_session_timeout, MG_TIMER_REPEAT, (mg_timer_handler_t)McpHttpServerTransportImpl::cbTimerHandler, this);
+
+	if (!m_handover_path.empty())
+	{
+		std::vector<int> socket_fds;
+		std::string state;
+		if (ReceiveHandover(m_handover_path, socket_fds, state))
+		{
+			// Every socket is adopted, also when this process runs fewer loops, so
+			// that no connection waiting in a backlog is lost.
+			for (size_t i = 0; i < socket_fds.size(); i++)
+			{
+				AdoptListener(*m_shards[i % shard_count], socket_fds[i]);
+			}
+
+			// The state is one session id per line.
+			std::lock_guard<std::mutex> lock(m_session_mutex);
+
+			size_t pos = 0;
+			size_t end;
+			while ((end = state.find('\n', pos)) != std::string::npos)
+			{
+				if (end > pos)
+				{
+					SessionInfo& session_info = m_sessions[state.substr(pos, end - pos)];
+					session_info.session_id = state.substr(pos, end - pos);
+					session_info.is_alive = 1;
+				}
+				pos = end + 1;
+			}
+
+			MCP_LOG_INFO("took over %s with %zu sockets and %zu sessions", m_host.c_str(), socket_fds.size(), m_sessions.size());
+		}
+	}
+
+	bool has_listener = false;
+	for (auto it = m_shards.begin(); it != m_shards.end(); it++)
+	{
+		if ((*it)->listeners.empty() && !OpenListener(**it))
+		{
+			MCP_LOG_WARNING("event loop %zu cannot listen on %s", (*it)->index, m_host.c_str());
+		}
+		has_listener = has_listener || !(*it)->listeners.empty();
+	}
+	if (!has_listener)
+	{
+		MCP_LOG_ERROR("cannot listen on %s", m_host.c_str());
+		FreeShards();
+		return false;
+	}
+
+	if (!m_handover_path.empty())
+	{
+		m_handover_fd = ListenHandover(m_handover_path);
+		if (m_handover_fd < 0)
+		{
+			MCP_LOG_WARNING("cannot offer handover at %s", m_handover_path.c_str());
+		}
+	}
 
-	mg_timer_init(&m_mgr.timers, &m_timer, m_session_timeout, MG_TIMER_REPEAT, (mg_timer_handler_t)McpHttpServerTransportImpl::cbTimerHandler, this);
+	if (m_use_authorization)
+	{
+		m_jwt_verifier = std::make_unique<McpJwtVerifier>(m_authorization_servers, m_url);
+	}
 
-	if (mg_http_listen(
-		&m_mgr,
-		m_host.c_str(),
-		(mg_event_handler_t)cbEvHander,
-		this) == nullptr)
+	for (size_t i = 1; i < m_shards.size(); i++)
+	{
+		Shard* shard = m_shards[i].get();
+		shard->thread = std::make_unique<std::thread>([this, shard]
+		{
+			while (m_is_running)
+			{
+				if (!ProcShard(*shard))
+				{
+					shard->is_drained = true;
+					break;
+				}
+			}
+		});
+	}
+
+	return true;
+}
+
+bool McpHttpServerTransportImpl::OpenListener(Shard& shard)
+{
+	mg_connection* conn;
+	if (m_shards.size() == 1)
+	{
+		conn = mg_http_listen(&shard.mgr, m_host.c_str(), (mg_event_handler_t)cbEvHander, &shard);
+	}
+	else
+	{
+		conn = mg_ext_http_listen_reuseport(&shard.mgr, m_host.c_str(), (mg_event_handler_t)cbEvHander, &shard);
+	}
+	if (conn == nullptr)
 	{
 		return false;
 	}
 
+	shard.listeners.push_back(conn);
+	return true;
+}
+
+mg_connection* McpHttpServerTransportImpl::AdoptListener(Shard& shard, int fd)
+{
+	mg_connection* conn = mg_ext_adopt_listener(&shard.mgr, (MG_SOCKET_TYPE)fd, m_host.c_str(), (mg_event_handler_t)cbEvHander, &shard);
+	if (conn == nullptr)
+	{
+		return nullptr;
+	}
+
+	shard.listeners.push_back(conn);
+	return conn;
+}
+
+bool McpHttpServerTransportImpl::ProcShard(Shard& shard)
+{
+	mg_mgr_poll(&shard.mgr, 50);
+	FlushStreams(shard);
+
+	if (m_is_draining)
+	{
+		return ProcDrain(shard);
+	}
+
 	return true;
 }
 
+void McpHttpServerTransportImpl::ProcHandover()
+{
+	// Listeners only change on open and while draining, so they can be read from here.
+	std::vector<int> socket_fds;
+	for (auto it = m_shards.begin(); it != m_shards.end(); it++)
+	{
+		for (auto it2 = (*it)->listeners.begin(); it2 != (*it)->listeners.end(); it2++)
+		{
+			socket_fds.push_back((int)(size_t)(*it2)->fd);
+		}
+	}
+
+	std::string state;
+	size_t session_count;
+	{
+		std::lock_guard<std::mutex> lock(m_session_mutex);
+
+		for (auto it = m_sessions.begin(); it != m_sessions.end(); it++)
+		{
+			state += it->first;
+			state += '\n';
+		}
+		session_count = m_sessions.size();
+	}
+
+	if (!SendHandover(m_handover_fd, socket_fds, state))
+	{
+		return;
+	}
+
+	// The new process owns the path now, so it is left in place.
+	CloseHandover(m_handover_fd, "");
+	m_handover_fd = -1;
+
+	m_is_draining = true;
+
+	MCP_LOG_INFO("handed %s over with %zu sessions, draining", m_host.c_str(), session_count);
+}
+
+bool McpHttpServerTransportImpl::ProcDrain(Shard& shard)
+{
+	for (auto it = shard.listeners.begin(); it != shard.listeners.end(); it++)
+	{
+		(*it)->is_closing = 1;
+	}
+	shard.listeners.clear();
+
+	std::lock_guard<std::mutex> lock(shard.mutex);
+
+	// Idle keep-alive connections are closed so that clients reconnect to the new process.
+	bool has_connection = false;
+	for (mg_connection* conn = shard.mgr.conns; conn != nullptr; conn = conn->next)
+	{
+		if (conn->is_listening || conn->fn != (mg_event_handler_t)cbEvHander)	// skips the wakeup pipe
+		{
+			continue;
+		}
+
+		has_connection = true;
+		if (shard.streams.find(conn->id) == shard.streams.end())
+		{
+			conn->is_draining = 1;
+		}
+	}
+
+	return has_connection;
+}
+
+void McpHttpServerTransportImpl::FreeShards()
+{
+	OnStop();
+
+	if (!m_shards.empty())
+	{
+		mg_timer_free(&m_shards[0]->mgr.timers, &m_timer);
+	}
+	for (auto it = m_shards.begin(); it != m_shards.end(); it++)
+	{
+		mg_mgr_free(&(*it)->mgr);
+	}
+	m_shards.clear();
+}
+
 void McpHttpServerTransportImpl::UpdateUrl()
 {
 	if (m_use_tls)
@@ -110,46 +372,142 @@ void McpHttpServerTransportImpl::UpdateUrl()
 	m_url.append(m_entry_point);
 }
 
+// The loops stop calling the handler, but the shards stay until FreeShards, so
+// responses still being sent find their streams.
+void McpHttpServerTransportImpl::OnStop()
+{
+	m_is_running = false;
+
+	for (auto it = m_shards.begin(); it != m_shards.end(); it++)
+	{
+		if ((*it)->thread)
+		{
+			(*it)->thread->join();
+			(*it)->thread.reset();
+		}
+	}
+}
+
 void McpHttpServerTransportImpl::OnClose()
 {
-	mg_timer_free(&m_mgr.timers, &m_timer);
-	mg_mgr_free(&m_mgr);
+	CloseHandover(m_handover_fd, m_handover_path);
+	m_handover_fd = -1;
+
+	FreeShards();
+	FreeTlsContext();
+	m_jwt_verifier.reset();
 }
 
 bool McpHttpServerTransportImpl::OnProcRequest()
 {
-	mg_mgr_poll(&m_mgr, 50);
+	bool is_open = ProcShard(*m_shards[0]);
+
+	if (m_handover_fd >= 0 && !m_is_draining)
+	{
+		ProcHandover();
+	}
+	if (m_is_draining)
+	{
+		// Done once every loop has finished its streams.
+		if (is_open)
+		{
+			return true;
+		}
+		for (size_t i = 1; i < m_shards.size(); i++)
+		{
+			if (!m_shards[i]->is_drained)
+			{
+				return true;
+			}
+		}
+
+		MCP_LOG_INFO("drained %s", m_host.c_str());
+		return false;
+	}
+
 	return true;
 }
 
 void McpHttpServerTransportImpl::cbEvHander(void* connection, int event_code, void* event_data)
 {
 	mg_connection* conn = (mg_connection*)connection;
-	McpHttpServerTransportImpl* self = (McpHttpServerTransportImpl*)conn->fn_data;
+	Shard* shard = (Shard*)conn->fn_data;
+	McpHttpServerTransportImpl* self = shard->transport;
 
 	if (event_code == MG_EV_ACCEPT)
 	{
 		if (self->m_use_tls)
 		{
+#if MG_TLS == MG_TLS_OPENSSL
+			if (!self->InitTls(conn))
+			{
+				mg_error(conn, "TLS init");
+			}
+#else
 			struct mg_tls_opts opts =
 			{
 				.cert = mg_file_read(&mg_fs_posix, self->m_cert_file.c_str()),
 				.key = mg_file_read(&mg_fs_posix, self->m_key_file.c_str())
 			};
 			mg_tls_init(conn, &opts);
+			mg_free((void*)opts.cert.buf);
+			mg_free((void*)opts.key.buf);
+#endif
 		}
 	}
 	else if (event_code == MG_EV_CLOSE)
 	{
-		std::lock_guard<std::recursive_mutex> lock(self->m_mutex);
+		shard->shed_bodies.erase(conn->id);
+
+		std::lock_guard<std::mutex> lock(shard->mutex);
 
-		for (auto it = self->m_sessions.begin(); it != self->m_sessions.end(); it++)
+		shard->streams.erase(conn->id);
+	}
+	else if (event_code == MG_EV_READ)
+	{
+		auto it = shard->shed_bodies.find(conn->id);
+		if (it != shard->shed_bodies.end())
 		{
-			SessionInfo& session_info = it->second;
-			if (session_info.connection == connection)
+			// Read off and dropped, so the client sees the 503 instead of a reset.
+			size_t len = conn->recv.len < it->second ? conn->recv.len : it->second;
+			it->second -= len;
+			conn->recv.len = 0;
+			if (it->second == 0)
 			{
-				session_info.connection = nullptr;
-				break;
+				shard->shed_bodies.erase(it);
+				conn->is_draining = 1;
+			}
+		}
+	}
+	else if (event_code == MG_EV_HTTP_HDRS)
+	{
+		// Sent again on every read until the body is in. A request that arrived whole is left
+		// to MG_EV_HTTP_MSG, which can still let notifications through.
+		struct mg_http_message* hm = (struct mg_http_message*)event_data;
+		size_t body_received = conn->recv.len - (size_t)(hm->body.buf - (char*)conn->recv.buf);
+		if (hm->body.len > body_received &&
+			mg_strcasecmp(hm->method, mg_str("POST")) == 0 &&
+			mg_match(hm->uri, mg_str(self->m_entry_point.c_str()), NULL))
+		{
+			struct mg_str* session_header = mg_http_get_header(hm, "mcp-session-id");
+			std::string session_id = session_header != nullptr ? std::string(session_header->buf, session_header->len) : "";
+
+			if (self->m_is_draining || !self->m_handler->CanAccept(session_id, ""))
+			{
+				MCP_LOG_WARNING("shedding a request from session %s before reading its body", session_id.c_str());
+				mg_http_reply(conn, 503, "Retry-After: 1\r\nConnection: close\r\n", "");
+
+				// Emptying the buffer detaches the HTTP parser. A body of known length is then
+				// discarded as it arrives, and the connection closed after it.
+				if (mg_http_get_header(hm, "Content-Length") != nullptr)
+				{
+					shard->shed_bodies[conn->id] = hm->body.len - body_received;
+				}
+				else
+				{
+					conn->is_draining = 1;
+				}
+				conn->recv.len = 0;
 			}
 		}
 	}
@@ -200,36 +558,37 @@ void McpHttpServerTransportImpl::cbEvHander(void* connection, int event_code, vo
 					{
 						ret_code = 401;
 					}
-					else if (7 <= auth_token.length())
+					else if (auth_token.length() > 7 && mg_strcasecmp(mg_str_n(auth_token.c_str(), 7), mg_str("Bearer ")) == 0)
 					{
-						std::string::size_type aPos = auth_token.find_first_of("Bearer ");
-						if (aPos != std::string::npos)
+						switch (self->m_jwt_verifier->Verify(auth_token.substr(7)))
 						{
-							try
-							{
-								std::string token = auth_token.substr(aPos + 7);
-								auto decoded = jwt::decode(token);
-								auto payload = decoded.get_payload_json();
-
-								std::string aud_value = payload["aud"].get<std::string>();
-								if (aud_value == self->m_url)
-								{
-									ret_code = 0;
-								}
-								else
-								{
-									ret_code = 403;
-								}
-							}
-							catch (std::exception& ex)
-							{
-								ret_code = 400;
-							}
+						case MCP_JWT_OK:
+							ret_code = 0;
+							break;
+						case MCP_JWT_INVALID:
+							ret_code = 401;
+							break;
+						case MCP_JWT_FORBIDDEN:
+							ret_code = 403;
+							break;
+						case MCP_JWT_PENDING:
+							ret_code = 503;
+							break;
+						default:
+							ret_code = 400;
+							break;
 						}
 					}
 
+					if (ret_code == 503)
+					{
+						MCP_LOG_INFO("deferred a request until the signing keys are fetched");
+						mg_http_reply(conn, 503, "Retry-After: 1\r\n", "");
+						return;
+					}
 					if (ret_code != 0)
 					{
+						MCP_LOG_INFO("rejected unauthorized request with %d", ret_code);
 						std::string authenticate_header = "WWW-Authenticate: Bearer resource_metadata=\"";
 						authenticate_header.append(self->m_host);
 						authenticate_header.append("/.well-known/oauth-protected-resource");
@@ -245,38 +604,88 @@ void McpHttpServerTransportImpl::cbEvHander(void* connection, int event_code, vo
 					}
 				}
 
-				char* method = mg_json_get_str(hm->body, "$.method");
-				if (method != nullptr)
+				// The body is left for the server to parse. It is only scanned here for its method
+				// when the request opens a session or would otherwise be shed.
+				auto get_method = [hm]()
 				{
-					std::lock_guard<std::recursive_mutex> lock(self->m_mutex);
+					char* method_str = mg_json_get_str(hm->body, "$.method");
+					std::string method = method_str != nullptr ? method_str : "";
+					mg_free(method_str);
+					return method;
+				};
 
-					SessionInfo* session_info = nullptr;
-					if (strcmp(method, "initialize") == 0)
+				size_t body_start = 0;
+				while (body_start < hm->body.len && isspace((unsigned char)hm->body.buf[body_start]))
+				{
+					body_start++;
+				}
+				bool is_batch = body_start < hm->body.len && hm->body.buf[body_start] == '[';
+
+				std::string method;
+				if (session_id.empty() && !is_batch)
+				{
+					method = get_method();
+					if (method.empty())
 					{
-						session_info = self->CreateSession(conn);
+						mg_http_reply(conn, 405, "", "");
+						return;
 					}
-					else
+				}
+
+				// The same check for a body that arrived with its headers, which is cheap to
+				// look into here. Notifications such as cancellations, and methods the server
+				// always answers, are let through.
+				if (self->m_is_draining || !self->m_handler->CanAccept(session_id, ""))
+				{
+					if (method.empty() && !is_batch)
 					{
-						session_info = self->FindSession(session_id);
+						method = get_method();
 					}
-					if (session_info == nullptr)
+
+					if (is_batch || (method.compare(0, 14, "notifications/") != 0 &&
+						(self->m_is_draining || !self->m_handler->CanAccept(session_id, method))))
 					{
-						mg_http_reply(conn, 400, "", "");
+						MCP_LOG_WARNING("shedding %s from session %s", is_batch ? "a batch" : method.c_str(), session_id.c_str());
+						mg_http_reply(conn, 503, "Retry-After: 1\r\n", "");
 						return;
 					}
-					session_info->connection = connection;
-					session_info->notification_is_start = false;
+				}
 
-					std::string request_str = std::string(hm->body.buf, hm->body.buf + hm->body.len);
-					if (!self->m_handler->OnRecv(session_info->session_id, request_str))
-					{
-						std::string headers = "mcp-session-id: " + session_info->session_id + "\r\n";
-						mg_http_reply(conn, 202, headers.c_str(), "");
-					}
+				if (method == "initialize")
+				{
+					session_id = self->CreateSession();
 				}
-				else
+				else if (!self->FindSession(session_id))
 				{
-					mg_http_reply(conn, 405, "", "");
+					MCP_LOG_DEBUG("unknown session %s", session_id.c_str());
+					mg_http_reply(conn, 400, "", "");
+					return;
+				}
+
+				{
+					std::lock_guard<std::mutex> lock(shard->mutex);
+
+					// A kept-alive connection starts over, without frames left from its previous request.
+					StreamInfo& stream_info = shard->streams[conn->id];
+					stream_info = StreamInfo();
+					stream_info.session_id = session_id;
+					stream_info.connection = connection;
+					stream_info.notification_is_start = false;
+					stream_info.notification_is_finish = false;
+					stream_info.is_cancelled = false;
+					stream_info.is_dirty = false;
+				}
+
+				if (!self->m_handler->OnRecv(session_id, self->GetStreamId(*shard, conn->id), std::string(hm->body.buf, hm->body.len)))
+				{
+					{
+						std::lock_guard<std::mutex> lock(shard->mutex);
+
+						shard->streams.erase(conn->id);
+					}
+
+					std::string headers = "mcp-session-id: " + session_id + "\r\n";
+					mg_http_reply(conn, 202, headers.c_str(), "");
 				}
 			}
 		}
@@ -317,115 +726,389 @@ void McpHttpServerTransportImpl::cbEvHander(void* connection, int event_code, vo
 			mg_http_reply(conn, 405, "", "");
 		}
 	}
-	else if (event_code == MG_EV_POLL)
+}
+
+void McpHttpServerTransportImpl::FlushStreams(Shard& shard)
+{
+	std::lock_guard<std::mutex> lock(shard.mutex);
+
+	std::vector<unsigned long> dirty_streams;
+	dirty_streams.swap(shard.dirty_streams);
+
+	for (auto it = dirty_streams.begin(); it != dirty_streams.end(); it++)
 	{
-		std::lock_guard<std::recursive_mutex> lock(self->m_mutex);
+		// The connection may have closed since the stream was queued.
+		auto it2 = shard.streams.find(*it);
+		if (it2 == shard.streams.end())
+		{
+			continue;
+		}
+
+		StreamInfo& stream_info = it2->second;
+		stream_info.is_dirty = false;
 
-		for (auto it = self->m_sessions.begin(); it != self->m_sessions.end(); it++)
+		mg_connection* conn = (mg_connection*)stream_info.connection;
+		if (stream_info.is_cancelled)
 		{
-			SessionInfo& session_info = it->second;
-			if (session_info.connection == connection)
+			conn->is_closing = 1;
+			shard.streams.erase(it2);
+			continue;
+		}
+
+		while (!stream_info.notifications.empty())
+		{
+			if (!stream_info.notification_is_start)
 			{
-				mg_connection* target_conn = (mg_connection*)session_info.connection;
-				while (!session_info.notifications.empty())
-				{
-					if (!session_info.notification_is_start)
-					{
-						std::string headers =
-							"HTTP/1.1 200 OK\r\n"
-							"Transfer-Encoding: chunked\r\n"
-							"Content-Type: text/event-stream\r\nmcp-session-id: " + session_info.session_id + "\r\n"
-							"\r\n";
-						mg_printf(conn, headers.c_str());
-
-						session_info.notification_is_start = true;
-					}
+				std::string headers =
+					"HTTP/1.1 200 OK\r\n"
+					"Transfer-Encoding: chunked\r\n"
+					"Content-Type: text/event-stream\r\nmcp-session-id: " + stream_info.session_id + "\r\n"
+					"\r\n";
+				mg_printf(conn, headers.c_str());
 
-					std::string& notification_str = session_info.notifications.front();
-					mg_http_printf_chunk(target_conn, "event: message\ndata: %s\n\n", notification_str.c_str());
-					session_info.notifications.pop();
-				}
-				if (session_info.notification_is_finish)
-				{
-					mg_http_write_chunk(conn, "", 0);
-					session_info.notification_is_finish = false;
-				}
-				break;
+				stream_info.notification_is_start = true;
 			}
+
+			std::string& notification_str = stream_info.notifications.front();
+			mg_http_printf_chunk(conn, "event: message\ndata: %s\n\n", notification_str.c_str());
+			stream_info.notifications.pop();
+		}
+		if (stream_info.notification_is_finish)
+		{
+			mg_http_write_chunk(conn, "", 0);
+			shard.streams.erase(it2);
 		}
 	}
 }
 
-void McpHttpServerTransportImpl::OnSendResponse(const std::string& session_id, const std::string& notification_str, bool is_finish)
+unsigned long long McpHttpServerTransportImpl::GetStreamId(const Shard& shard, unsigned long conn_id) const
 {
-	std::lock_guard<std::recursive_mutex> lock(m_mutex);
+	return (unsigned long long)conn_id * m_shards.size() + shard.index;
+}
 
-	auto it = m_sessions.find(session_id);
-	if (it != m_sessions.end())
+McpHttpServerTransportImpl::Shard* McpHttpServerTransportImpl::FindShard(unsigned long long stream_id, unsigned long& conn_id) const
+{
+	if (m_shards.empty())
+	{
+		return nullptr;
+	}
+
+	conn_id = (unsigned long)(stream_id / m_shards.size());
+	return m_shards[stream_id % m_shards.size()].get();
+}
+
+void McpHttpServerTransportImpl::OnSendResponse(const std::string& session_id, unsigned long long stream_id, const std::string& notification_str, bool is_finish)
+{
+	unsigned long conn_id;
+	Shard* shard = FindShard(stream_id, conn_id);
+	if (shard == nullptr)
+	{
+		return;
+	}
+
+	std::lock_guard<std::mutex> lock(shard->mutex);
+
+	auto it = shard->streams.find(conn_id);
+	if (it != shard->streams.end() && it->second.session_id == session_id)
+	{
+		StreamInfo& stream_info = it->second;
+		if (stream_info.notification_is_finish)
+		{
+			// Late notifications must not reopen a stream that has its final response.
+			return;
+		}
+		if (!is_finish && stream_info.notifications.size() >= MAX_QUEUED_NOTIFICATIONS)
+		{
+			// A client that stopped reading loses notifications, never the final response.
+			return;
+		}
+		stream_info.notifications.push(notification_str);
+		stream_info.notification_is_finish = is_finish;
+		Wakeup(*shard, conn_id, stream_info);
+	}
+}
+
+void McpHttpServerTransportImpl::OnCancelResponse(const std::string& session_id, unsigned long long stream_id)
+{
+	unsigned long conn_id;
+	Shard* shard = FindShard(stream_id, conn_id);
+	if (shard == nullptr)
+	{
+		return;
+	}
+
+	std::lock_guard<std::mutex> lock(shard->mutex);
+
+	auto it = shard->streams.find(conn_id);
+	if (it != shard->streams.end() && it->second.session_id == session_id)
+	{
+		// Nothing more is sent on a cancelled stream; the connection is closed on the next flush.
+		StreamInfo& stream_info = it->second;
+		std::queue<std::string>().swap(stream_info.notifications);
+		stream_info.is_cancelled = true;
+		Wakeup(*shard, conn_id, stream_info);
+	}
+}
+
+void McpHttpServerTransportImpl::Wakeup(Shard& shard, unsigned long conn_id, StreamInfo& stream_info)
+{
+	// A stream is queued and the loop woken once until it has been flushed. If the
+	// pipe is full, the flush after the next poll picks the stream up anyway.
+	if (!stream_info.is_dirty)
+	{
+		stream_info.is_dirty = true;
+		shard.dirty_streams.push_back(conn_id);
+		if (shard.wakeup_socket != MG_INVALID_SOCKET)
+		{
+			send(shard.wakeup_socket, "", 1, MSG_NONBLOCKING);
+		}
+	}
+}
+
+// The handler flushes the dirty list directly instead of looking up a connection per
+// wakeup, which mg_wakeup() does by walking all of them.
+bool McpHttpServerTransportImpl::OpenWakeup(Shard& shard)
+{
+	shard.wakeup_socket = mg_ext_wakeup_init(&shard.mgr, (mg_event_handler_t)cbWakeupHandler, &shard);
+	return shard.wakeup_socket != MG_INVALID_SOCKET;
+}
+
+void McpHttpServerTransportImpl::cbWakeupHandler(void* connection, int event_code, void* /* event_data */)
+{
+	mg_connection* conn = (mg_connection*)connection;
+	Shard* shard = (Shard*)conn->fn_data;
+
+	if (event_code == MG_EV_READ)
+	{
+		conn->recv.len = 0;
+		shard->transport->FlushStreams(*shard);
+	}
+	else if (event_code == MG_EV_CLOSE)
+	{
+		std::lock_guard<std::mutex> lock(shard->mutex);
+
+		closesocket(shard->wakeup_socket);
+		shard->wakeup_socket = MG_INVALID_SOCKET;
+	}
+}
+
+#if MG_TLS == MG_TLS_OPENSSL
+static SSL_CTX* CreateTlsContext(const std::string& cert_file, const std::string& key_file)
+{
+	SSL_CTX* ctx = SSL_CTX_new(TLS_server_method());
+	if (ctx == nullptr)
+	{
+		ERR_clear_error();
+		return nullptr;
+	}
+
+	if (SSL_CTX_use_certificate_chain_file(ctx, cert_file.c_str()) != 1
+		|| SSL_CTX_use_PrivateKey_file(ctx, key_file.c_str(), SSL_FILETYPE_PEM) != 1
+		|| SSL_CTX_check_private_key(ctx) != 1)
+	{
+		SSL_CTX_free(ctx);
+		ERR_clear_error();
+		return nullptr;
+	}
+
+	const char* id = "mcp-cpp";
+	SSL_CTX_set_min_proto_version(ctx, TLS1_2_VERSION);
+	SSL_CTX_set_mode(ctx, SSL_MODE_ACCEPT_MOVING_WRITE_BUFFER);
+	SSL_CTX_set_session_id_context(ctx, (const unsigned char*)id, (unsigned int)strlen(id));
+	SSL_CTX_set_session_cache_mode(ctx, SSL_SESS_CACHE_SERVER);
+	SSL_CTX_clear_options(ctx, SSL_OP_NO_TICKET);
+
+	return ctx;
+}
+
+// Called on open, then only from the reload thread. Keeps the current context when the
+// files are unchanged or cannot be loaded.
+bool McpHttpServerTransportImpl::LoadTlsContext()
+{
+	std::shared_ptr<void> current = m_tls_ctx.load();
+
+	std::error_code ec;
+	std::filesystem::file_time_type cert_time = std::filesystem::last_write_time(m_cert_file, ec);
+	if (ec)
+	{
+		return current != nullptr;
+	}
+	std::filesystem::file_time_type key_time = std::filesystem::last_write_time(m_key_file, ec);
+	if (ec)
+	{
+		return current != nullptr;
+	}
+	if (current != nullptr && cert_time == m_tls_cert_time && key_time == m_tls_key_time)
+	{
+		return true;
+	}
+
+	// A pair that fails is tried again once either file changes, such as when a rotation
+	// caught half-way is completed.
+	m_tls_cert_time = cert_time;
+	m_tls_key_time = key_time;
+
+	SSL_CTX* ctx = CreateTlsContext(m_cert_file, m_key_file);
+	if (ctx == nullptr)
+	{
+		if (current != nullptr)
+		{
+			MCP_LOG_WARNING("cannot reload the certificate %s, keeping the current one", m_cert_file.c_str());
+		}
+		return current != nullptr;
+	}
+
+	if (current != nullptr)
+	{
+		// Tickets issued before the reload stay valid.
+		unsigned char ticket_keys[80];
+		if (SSL_CTX_get_tlsext_ticket_keys((SSL_CTX*)current.get(), ticket_keys, sizeof(ticket_keys)) == 1)
+		{
+			SSL_CTX_set_tlsext_ticket_keys(ctx, ticket_keys, sizeof(ticket_keys));
+		}
+		OPENSSL_cleanse(ticket_keys, sizeof(ticket_keys));
+
+		MCP_LOG_INFO("reloaded the certificate %s", m_cert_file.c_str());
+	}
+
+	// Open connections hold their own reference to the old context.
+	m_tls_ctx.store(std::shared_ptr<void>(ctx, [](void* p) { SSL_CTX_free((SSL_CTX*)p); }));
+	return true;
+}
+
+void McpHttpServerTransportImpl::ProcTlsReload()
+{
+	std::unique_lock<std::mutex> lock(m_tls_mutex);
+
+	while (!m_tls_cv.wait_for(lock, TLS_RELOAD_INTERVAL, [this] { return m_is_tls_stopping; }))
+	{
+		lock.unlock();
+		LoadTlsContext();
+		lock.lock();
+	}
+}
+
+void McpHttpServerTransportImpl::FreeTlsContext()
+{
+	if (m_tls_thread)
 	{
-		SessionInfo& session_info = it->second;
-		session_info.notifications.push(notification_str);
-		session_info.notification_is_finish = is_finish;
+		{
+			std::lock_guard<std::mutex> lock(m_tls_mutex);
+
+			m_is_tls_stopping = true;
+		}
+		m_tls_cv.notify_one();
+		m_tls_thread->join();
+		m_tls_thread.reset();
 	}
+
+	m_tls_ctx.store(nullptr);
+}
+
+bool McpHttpServerTransportImpl::InitTls(mg_connection* conn)
+{
+	std::shared_ptr<void> ctx = m_tls_ctx.load();
+
+	return ctx != nullptr && mg_ext_tls_accept(conn, (SSL_CTX*)ctx.get());
+}
+#else
+bool McpHttpServerTransportImpl::LoadTlsContext()
+{
+	return false;
 }
 
+void McpHttpServerTransportImpl::ProcTlsReload()
+{
+}
+
+void McpHttpServerTransportImpl::FreeTlsContext()
+{
+}
+
+bool McpHttpServerTransportImpl::InitTls(mg_connection*)
+{
+	return false;
+}
+#endif
+
 void McpHttpServerTransportImpl::cbTimerHandler(void* timer_data)
 {
 	McpHttpServerTransportImpl* self = (McpHttpServerTransportImpl*)timer_data;
 	self->ClearSession();
 }
 
-McpHttpServerTransportImpl::SessionInfo* McpHttpServerTransportImpl::CreateSession(void* connection)
+std::string McpHttpServerTransportImpl::CreateSession()
 {
 	std::string session_id = CreateSessionId();
-	SessionInfo& session_info = m_sessions[session_id];
+	{
+		std::lock_guard<std::mutex> lock(m_session_mutex);
 
-	session_info.session_id = session_id;
-	session_info.connection = connection;
-	session_info.is_alive = 1;
+		SessionInfo& session_info = m_sessions[session_id];
+		session_info.session_id = session_id;
+		session_info.is_alive = 1;
+	}
 
-	return &session_info;
+	MCP_LOG_INFO("session %s created", session_id.c_str());
+	return session_id;
 }
 
-McpHttpServerTransportImpl::SessionInfo* McpHttpServerTransportImpl::FindSession(std::string session_id)
+bool McpHttpServerTransportImpl::FindSession(const std::string& session_id)
 {
+	std::lock_guard<std::mutex> lock(m_session_mutex);
+
 	auto it = m_sessions.find(session_id);
 	if (it == m_sessions.end())
 	{
-		return nullptr;
+		return false;
 	}
 
-	SessionInfo& session_info = it->second;
-	session_info.is_alive = 1;
-
-	return &session_info;
+	it->second.is_alive = 1;
+	return true;
 }
 
 void McpHttpServerTransportImpl::EraseSession(std::string session_id)
 {
-	auto it = m_sessions.find(session_id);
-	if (it != m_sessions.end())
 	{
-		m_sessions.erase(it);
+		std::lock_guard<std::mutex> lock(m_session_mutex);
+
+		if (m_sessions.erase(session_id) == 0)
+		{
+			return;
+		}
 	}
+
+	MCP_LOG_INFO("session %s deleted", session_id.c_str());
+	m_handler->OnClose(session_id);
 }
 
 void McpHttpServerTransportImpl::ClearSession()
 {
-	auto it = m_sessions.begin();
-	while (it != m_sessions.end())
+	std::vector<std::string> expired_sessions;
 	{
-		SessionInfo& session_info = it->second;
-		if (session_info.is_alive > 0)
-		{
-			session_info.is_alive--;
-			it++;
-		}
-		else
+		std::lock_guard<std::mutex> lock(m_session_mutex);
+
+		auto it = m_sessions.begin();
+		while (it != m_sessions.end())
 		{
-			it = m_sessions.erase(it);
+			SessionInfo& session_info = it->second;
+			if (session_info.is_alive > 0)
+			{
+				session_info.is_alive--;
+				it++;
+			}
+			else
+			{
+				expired_sessions.emplace_back(it->first);
+				it = m_sessions.erase(it);
+			}
 		}
 	}
+
+	for (auto it = expired_sessions.begin(); it != expired_sessions.end(); it++)
+	{
+		MCP_LOG_INFO("session %s expired", it->c_str());
+		m_handler->OnClose(*it);
+	}
 }
 
 }
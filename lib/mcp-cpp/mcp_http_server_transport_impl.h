@@ -18,6 +18,12 @@
 #pragma once
 
 #include "mcp-cpp/mcp_http_server_transport.h"
+#include "mcp_jwt_verifier.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <filesystem>
+#include <unordered_map>
 
 namespace Mcp {
 
@@ -34,6 +40,8 @@ public:
 		const std::string& authorization_servers,
 		const std::string& scopes_supported
 	);
+	virtual void SetHandoverPath(const std::string& path);
+	virtual void SetEventLoopCount(size_t count);
 
 private:
 	std::string m_host;
@@ -44,11 +52,36 @@ private:
 	std::string m_cert_file;
 	std::string m_key_file;
 
+	// The certificate and key are parsed once into a context shared by every connection.
+	// A thread of its own parses them again when either file changes on disk and swaps
+	// in the new context, so accepting never waits on the files.
+	std::atomic<std::shared_ptr<void>> m_tls_ctx;	// SSL_CTX
+	std::filesystem::file_time_type m_tls_cert_time;
+	std::filesystem::file_time_type m_tls_key_time;
+	std::unique_ptr<std::thread> m_tls_thread;
+	std::condition_variable m_tls_cv;
+	std::mutex m_tls_mutex;	// for m_tls_cv
+	bool m_is_tls_stopping;
+
+	bool LoadTlsContext();
+	void ProcTlsReload();
+	void FreeTlsContext();
+	bool InitTls(mg_connection* conn);
+
 	bool m_use_authorization;
 	std::string m_authorization_servers;
 	std::string m_scopes_supported;
+	std::unique_ptr<McpJwtVerifier> m_jwt_verifier;
+
+	std::string m_handover_path;
+	int m_handover_fd;
+	std::atomic<bool> m_is_draining;
+
+	size_t m_event_loop_count;
+	std::atomic<bool> m_is_running;
 
 	virtual bool OnOpen();
+	virtual void OnStop();
 	virtual void OnClose();
 
 	std::string m_url;
@@ -56,30 +89,69 @@ private:
 	void UpdateUrl();
 
 	virtual bool OnProcRequest();
-	virtual void OnSendResponse(const std::string& session_id, const std::string& notification_str, bool is_finish);
+	virtual void OnSendResponse(const std::string& session_id, unsigned long long stream_id, const std::string& notification_str, bool is_finish);
+	virtual void OnCancelResponse(const std::string& session_id, unsigned long long stream_id);
+
+	struct StreamInfo {
+		std::string session_id;
+		void* connection;
+
+		std::queue<std::string> notifications;
+		bool notification_is_start;
+		bool notification_is_finish;
+		bool is_cancelled;
+		bool is_dirty;	// queued in dirty_streams
+	};
+
+	// One mongoose event loop. A stream belongs to the loop that accepted its connection,
+	// and its id carries the loop index so that responses go straight to that loop.
+	struct Shard {
+		McpHttpServerTransportImpl* transport;
+		size_t index;
+		mg_mgr mgr;
+		std::vector<mg_connection*> listeners;
+
+		std::unordered_map<unsigned long, StreamInfo> streams;	// by connection id
+		std::vector<unsigned long> dirty_streams;	// streams with output or a cancellation to process
+		std::mutex mutex;
 
-	mg_mgr m_mgr;
-	mg_timer m_timer;
+		std::unordered_map<unsigned long, size_t> shed_bodies;	// by connection id, body bytes left to discard; loop thread only
+
+		MG_SOCKET_TYPE wakeup_socket;	// write end of the loop's wakeup pipe
+		std::atomic<bool> is_drained;
+		std::unique_ptr<std::thread> thread;	// none for the first loop, which runs in ProcRequest
+	};
+	std::vector<std::unique_ptr<Shard>> m_shards;
+	mg_timer m_timer;	// on the first loop
+
+	bool OpenListener(Shard& shard);
+	mg_connection* AdoptListener(Shard& shard, int fd);
+	bool ProcShard(Shard& shard);
+	void ProcHandover();
+	bool ProcDrain(Shard& shard);
+	void FreeShards();
+
+	unsigned long long GetStreamId(const Shard& shard, unsigned long conn_id) const;
+	Shard* FindShard(unsigned long long stream_id, unsigned long& conn_id) const;
+	bool OpenWakeup(Shard& shard);
+	void Wakeup(Shard& shard, unsigned long conn_id, StreamInfo& stream_info);
+	void FlushStreams(Shard& shard);
 
 	static void cbEvHander(void* connection, int event_code, void* event_data);
+	static void cbWakeupHandler(void* connection, int event_code, void* event_data);
 	static void cbTimerHandler(void* timer_data);
 
 	struct SessionInfo {
 		std::string session_id;
 		int is_alive;
-
-		void* connection;
-
-		std::queue<std::string> notifications;
-		bool notification_is_start;
-		bool notification_is_finish;
 	};
 
+	// Shared by all loops, so any of them can serve a session.
 	std::map<std::string, SessionInfo> m_sessions;
-	std::recursive_mutex m_mutex;
+	std::mutex m_session_mutex;
 
-	SessionInfo* CreateSession(void* connection);
-	SessionInfo* FindSession(std::string session_id);
+	std::string CreateSession();
+	bool FindSession(const std::string& session_id);
 	void EraseSession(std::string session_id);
 	void ClearSession();
 };
@@ -0,0 +1,328 @@
+/*
+ *  Copyright (C) 2025 UmeSoftware LLC
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "mcp_input_validator.h"
+
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <limits>
+
+namespace Mcp {
+
+McpInputValidator::McpInputValidator()
+	: m_required_count(0)
+{
+}
+
+McpInputValidator::McpInputValidator(const std::vector<McpProperty>& properties)
+	: m_required_count(0)
+{
+	for (auto it = properties.begin(); it != properties.end(); it++)
+	{
+		McpCompiledProperty property;
+		property.name = it->name;
+		property.type = it->type == MCP_PROPERTY_TYPE_TEXT ? MCP_PROPERTY_TYPE_STRING : it->type;
+		property.required = it->required;
+		property.minimum = it->minimum.value_or(-std::numeric_limits<double>::infinity());
+		property.maximum = it->maximum.value_or(std::numeric_limits<double>::infinity());
+
+		for (auto it2 = it->enum_values.begin(); it2 != it->enum_values.end(); it2++)
+		{
+			if (property.type == MCP_PROPERTY_TYPE_NUMBER || property.type == MCP_PROPERTY_TYPE_INTEGER)
+			{
+				double value = 0;
+				auto result = std::from_chars(it2->data(), it2->data() + it2->size(), value);
+				if (result.ec == std::errc())
+				{
+					property.number_values.push_back(value);
+				}
+			}
+			else
+			{
+				property.string_values.push_back(*it2);
+			}
+		}
+
+		// Later declarations replace earlier ones, as AddTool always did.
+		auto it2 = std::find_if(m_properties.begin(), m_properties.end(), [&](const McpCompiledProperty& p) { return p.name == property.name; });
+		if (it2 != m_properties.end())
+		{
+			*it2 = std::move(property);
+		}
+		else
+		{
+			m_properties.push_back(std::move(property));
+		}
+	}
+
+	std::sort(m_properties.begin(), m_properties.end(), [](const McpCompiledProperty& a, const McpCompiledProperty& b) { return a.name < b.name; });
+	m_required_count = std::count_if(m_properties.begin(), m_properties.end(), [](const McpCompiledProperty& p) { return p.required; });
+}
+
+bool McpInputValidator::Has(std::string_view name) const
+{
+	return Find(name) != nullptr;
+}
+
+McpValidationResult McpInputValidator::Validate(const std::shared_ptr<const std::string>& buffer, const McpJsonToken& arguments_token, McpArguments& arguments, std::string& name) const
+{
+	arguments.m_buffer = buffer;
+
+	// Arguments without escapes point straight into the buffer. The rest are
+	// unescaped into one storage string, sized up front so views stay valid.
+	struct McpEscapedArgument {
+		size_t index;
+		McpJsonToken key;
+		McpJsonToken value;
+	};
+	std::vector<McpEscapedArgument> escaped_arguments;
+	size_t escaped_size = 0;
+	std::vector<const McpCompiledProperty*> matched;	// parallel to arguments.m_arguments
+	size_t required_count = 0;
+	McpValidationResult result = MCP_VALIDATION_OK;
+
+	McpJsonReader::ForEachMember(arguments_token, [&](const McpJsonToken& key, const McpJsonToken& value)
+	{
+		const McpCompiledProperty* property;
+		bool has_escape = McpJsonReader::HasEscape(key) || (value.type == MCP_JSON_TYPE_STRING && McpJsonReader::HasEscape(value));
+		if (McpJsonReader::HasEscape(key))
+		{
+			std::string unescaped_name;
+			McpJsonReader::AppendUnescaped(unescaped_name, key);
+			property = Find(unescaped_name);
+		}
+		else
+		{
+			property = Find(McpJsonReader::GetStringContent(key));
+		}
+
+		// The first occurrence of a repeated name wins.
+		if (property == nullptr || std::find(matched.begin(), matched.end(), property) != matched.end())
+		{
+			return true;
+		}
+
+		McpArguments::McpArgument argument;
+		argument.name = McpJsonReader::GetStringContent(key);
+		result = ReadValue(*property, value, argument);
+		if (result != MCP_VALIDATION_OK)
+		{
+			name = property->name;
+			return false;
+		}
+
+		if (has_escape)
+		{
+			escaped_arguments.push_back({ arguments.m_arguments.size(), key, value });
+			escaped_size += key.raw.size() + value.raw.size();
+		}
+		arguments.m_arguments.push_back(argument);
+		matched.push_back(property);
+
+		if (property->required)
+		{
+			required_count++;
+		}
+		return true;
+	});
+
+	if (result != MCP_VALIDATION_OK)
+	{
+		return result;
+	}
+
+	if (required_count < m_required_count)
+	{
+		for (auto it = m_properties.begin(); it != m_properties.end(); it++)
+		{
+			if (it->required && std::find(matched.begin(), matched.end(), &*it) == matched.end())
+			{
+				name = it->name;
+				break;
+			}
+		}
+		return MCP_VALIDATION_MISSING;
+	}
+
+	if (escaped_arguments.size() > 0)
+	{
+		auto storage = std::make_shared<std::string>();
+		storage->reserve(escaped_size);
+
+		for (auto it = escaped_arguments.begin(); it != escaped_arguments.end(); it++)
+		{
+			McpArguments::McpArgument& argument = arguments.m_arguments[it->index];
+
+			size_t offset = storage->size();
+			McpJsonReader::AppendUnescaped(*storage, it->key);
+			argument.name = std::string_view(storage->data() + offset, storage->size() - offset);
+
+			if (it->value.type == MCP_JSON_TYPE_STRING)
+			{
+				offset = storage->size();
+				McpJsonReader::AppendUnescaped(*storage, it->value);
+				argument.value = std::string_view(storage->data() + offset, storage->size() - offset);
+			}
+		}
+		arguments.m_storage = storage;
+	}
+
+	return MCP_VALIDATION_OK;
+}
+
+const McpInputValidator::McpCompiledProperty* McpInputValidator::Find(std::string_view name) const
+{
+	auto it = std::lower_bound(m_properties.begin(), m_properties.end(), name, [](const McpCompiledProperty& p, std::string_view n) { return p.name < n; });
+	if (it == m_properties.end() || it->name != name)
+	{
+		return nullptr;
+	}
+
+	return &*it;
+}
+
+McpValidationResult McpInputValidator::ReadValue(const McpCompiledProperty& property, const McpJsonToken& value, McpArguments::McpArgument& argument)
+{
+	argument.value = value.raw;
+	argument.int_value = 0;
+	argument.double_value = 0;
+	argument.bool_value = false;
+
+	McpPropertyType type = property.type;
+	if (type == MCP_PROPERTY_TYPE_UNKNOWN)
+	{
+		// Undeclared types take whatever kind of value was sent.
+		switch (value.type) {
+		case MCP_JSON_TYPE_BOOLEAN:
+			type = MCP_PROPERTY_TYPE_BOOLEAN;
+			break;
+		case MCP_JSON_TYPE_NUMBER:
+			type = MCP_PROPERTY_TYPE_NUMBER;
+			break;
+		case MCP_JSON_TYPE_STRING:
+			type = MCP_PROPERTY_TYPE_STRING;
+			break;
+		case MCP_JSON_TYPE_OBJECT:
+		case MCP_JSON_TYPE_ARRAY:
+			type = MCP_PROPERTY_TYPE_OBJECT;
+			break;
+		default:
+			argument.type = MCP_PROPERTY_TYPE_UNKNOWN;
+			return MCP_VALIDATION_OK;
+		}
+	}
+	argument.type = type;
+
+	switch (type) {
+	case MCP_PROPERTY_TYPE_STRING:
+		if (value.type != MCP_JSON_TYPE_STRING)
+		{
+			return MCP_VALIDATION_WRONG_TYPE;
+		}
+		argument.value = McpJsonReader::GetStringContent(value);
+
+		if (property.string_values.size() > 0 &&
+			std::none_of(property.string_values.begin(), property.string_values.end(), [&](const std::string& s) { return McpJsonReader::Equals(value, s); }))
+		{
+			return MCP_VALIDATION_NOT_IN_ENUM;
+		}
+		return MCP_VALIDATION_OK;
+
+	case MCP_PROPERTY_TYPE_INTEGER:
+	{
+		if (value.type != MCP_JSON_TYPE_NUMBER)
+		{
+			return MCP_VALIDATION_WRONG_TYPE;
+		}
+
+		const char* end = value.raw.data() + value.raw.size();
+		auto result = std::from_chars(value.raw.data(), end, argument.int_value);
+		if (result.ec == std::errc::result_out_of_range)
+		{
+			return MCP_VALIDATION_OUT_OF_RANGE;
+		}
+		if (result.ec != std::errc() || result.ptr != end)
+		{
+			// Fractions and exponents are fine as long as the value is whole, e.g. 1.0 or 1e3.
+			double double_value = 0;
+			std::from_chars(value.raw.data(), end, double_value);
+			if (std::trunc(double_value) != double_value)
+			{
+				return MCP_VALIDATION_WRONG_TYPE;
+			}
+			if (std::fabs(double_value) >= 9223372036854775808.0)
+			{
+				return MCP_VALIDATION_OUT_OF_RANGE;
+			}
+			argument.int_value = (int64_t)double_value;
+		}
+		return CheckNumber(property, (double)argument.int_value);
+	}
+
+	case MCP_PROPERTY_TYPE_NUMBER:
+	{
+		if (value.type != MCP_JSON_TYPE_NUMBER)
+		{
+			return MCP_VALIDATION_WRONG_TYPE;
+		}
+
+		auto result = std::from_chars(value.raw.data(), value.raw.data() + value.raw.size(), argument.double_value);
+		if (result.ec != std::errc())
+		{
+			return MCP_VALIDATION_OUT_OF_RANGE;
+		}
+		return CheckNumber(property, argument.double_value);
+	}
+
+	case MCP_PROPERTY_TYPE_BOOLEAN:
+		if (value.type != MCP_JSON_TYPE_BOOLEAN)
+		{
+			return MCP_VALIDATION_WRONG_TYPE;
+		}
+		argument.bool_value = value.raw == "true";
+		return MCP_VALIDATION_OK;
+
+	case MCP_PROPERTY_TYPE_OBJECT:
+		if (value.type != MCP_JSON_TYPE_OBJECT && !(property.type == MCP_PROPERTY_TYPE_UNKNOWN && value.type == MCP_JSON_TYPE_ARRAY))
+		{
+			return MCP_VALIDATION_WRONG_TYPE;
+		}
+		return MCP_VALIDATION_OK;
+
+	default:
+		return MCP_VALIDATION_WRONG_TYPE;
+	}
+}
+
+McpValidationResult McpInputValidator::CheckNumber(const McpCompiledProperty& property, double value)
+{
+	if (value < property.minimum || value > property.maximum)
+	{
+		return MCP_VALIDATION_OUT_OF_RANGE;
+	}
+
+	if (property.number_values.size() > 0 &&
+		std::find(property.number_values.begin(), property.number_values.end(), value) == property.number_values.end())
+	{
+		return MCP_VALIDATION_NOT_IN_ENUM;
+	}
+
+	return MCP_VALIDATION_OK;
+}
+
+}
@@ -0,0 +1,65 @@
+/*
+ *  Copyright (C) 2025 UmeSoftware LLC
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "mcp-cpp/mcp_type.h"
+#include "mcp_json_reader.h"
+
+namespace Mcp {
+
+enum McpValidationResult {
+	MCP_VALIDATION_OK,
+	MCP_VALIDATION_MISSING,		// a required argument is absent
+	MCP_VALIDATION_WRONG_TYPE,
+	MCP_VALIDATION_OUT_OF_RANGE,
+	MCP_VALIDATION_NOT_IN_ENUM
+};
+
+// A tool's input schema compiled once at AddTool time. Validate checks every declared
+// argument in a single pass over the request and fills McpArguments with typed values.
+// Arguments the schema does not declare are ignored.
+class McpInputValidator
+{
+public:
+	McpInputValidator();
+	explicit McpInputValidator(const std::vector<McpProperty>& properties);
+
+	bool Has(std::string_view name) const;
+
+	// On failure |name| is set to the offending argument.
+	McpValidationResult Validate(const std::shared_ptr<const std::string>& buffer, const McpJsonToken& arguments_token, McpArguments& arguments, std::string& name) const;
+
+private:
+	struct McpCompiledProperty {
+		std::string name;
+		McpPropertyType type;
+		bool required;
+		std::vector<std::string> string_values;	// enum of a string property
+		std::vector<double> number_values;	// enum of a number or integer property
+		double minimum;
+		double maximum;
+	};
+	std::vector<McpCompiledProperty> m_properties;	// sorted by name
+	size_t m_required_count;
+
+	const McpCompiledProperty* Find(std::string_view name) const;
+	static McpValidationResult ReadValue(const McpCompiledProperty& property, const McpJsonToken& value, McpArguments::McpArgument& argument);
+	static McpValidationResult CheckNumber(const McpCompiledProperty& property, double value);
+};
+
+}
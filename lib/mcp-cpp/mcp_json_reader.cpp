@@ -0,0 +1,455 @@
+/*
+ *  Copyright (C) 2025 UmeSoftware LLC
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "mcp_json_reader.h"
+
+namespace Mcp {
+
+static const int MAX_DEPTH = 64;
+
+bool McpJsonReader::Parse(std::string_view json, McpJsonToken& token)
+{
+	size_t pos = 0;
+
+	SkipSpace(json, pos);
+	if (!ParseValue(json, pos, token, 0))
+	{
+		return false;
+	}
+	SkipSpace(json, pos);
+
+	return pos == json.size();
+}
+
+std::string_view McpJsonReader::GetStringContent(const McpJsonToken& token)
+{
+	if (token.type != MCP_JSON_TYPE_STRING)
+	{
+		return std::string_view();
+	}
+
+	return token.raw.substr(1, token.raw.size() - 2);
+}
+
+bool McpJsonReader::HasEscape(const McpJsonToken& token)
+{
+	return GetStringContent(token).find('\\') != std::string_view::npos;
+}
+
+static int HexValue(char c)
+{
+	if (c >= '0' && c <= '9')
+	{
+		return c - '0';
+	}
+	if (c >= 'a' && c <= 'f')
+	{
+		return c - 'a' + 10;
+	}
+	if (c >= 'A' && c <= 'F')
+	{
+		return c - 'A' + 10;
+	}
+	return -1;
+}
+
+static void AppendUtf8(std::string& buffer, unsigned int code_point)
+{
+	if (code_point < 0x80)
+	{
+		buffer += (char)code_point;
+	}
+	else if (code_point < 0x800)
+	{
+		buffer += (char)(0xc0 | (code_point >> 6));
+		buffer += (char)(0x80 | (code_point & 0x3f));
+	}
+	else if (code_point < 0x10000)
+	{
+		buffer += (char)(0xe0 | (code_point >> 12));
+		buffer += (char)(0x80 | ((code_point >> 6) & 0x3f));
+		buffer += (char)(0x80 | (code_point & 0x3f));
+	}
+	else
+	{
+		buffer += (char)(0xf0 | (code_point >> 18));
+		buffer += (char)(0x80 | ((code_point >> 12) & 0x3f));
+		buffer += (char)(0x80 | ((code_point >> 6) & 0x3f));
+		buffer += (char)(0x80 | (code_point & 0x3f));
+	}
+}
+
+static unsigned int ReadHex4(std::string_view value, size_t pos)
+{
+	unsigned int code_point = 0;
+	for (size_t i = 0; i < 4; i++)
+	{
+		code_point = (code_point << 4) | (unsigned int)HexValue(value[pos + i]);
+	}
+	return code_point;
+}
+
+void McpJsonReader::AppendUnescaped(std::string& buffer, const McpJsonToken& token)
+{
+	std::string_view value = GetStringContent(token);
+
+	size_t start = 0;
+	size_t i = 0;
+	while (i < value.size())
+	{
+		if (value[i] != '\\')
+		{
+			i++;
+			continue;
+		}
+
+		buffer.append(value.data() + start, i - start);
+
+		char c = value[i + 1];
+		i += 2;
+		switch (c)
+		{
+		case 'b':
+			buffer += '\b';
+			break;
+		case 'f':
+			buffer += '\f';
+			break;
+		case 'n':
+			buffer += '\n';
+			break;
+		case 'r':
+			buffer += '\r';
+			break;
+		case 't':
+			buffer += '\t';
+			break;
+		case 'u':
+			{
+				unsigned int code_point = ReadHex4(value, i);
+				i += 4;
+				if (code_point >= 0xd800 && code_point < 0xdc00 &&
+					i + 6 <= value.size() && value[i] == '\\' && value[i + 1] == 'u')
+				{
+					unsigned int low = ReadHex4(value, i + 2);
+					if (low >= 0xdc00 && low < 0xe000)
+					{
+						code_point = 0x10000 + ((code_point - 0xd800) << 10) + (low - 0xdc00);
+						i += 6;
+					}
+				}
+				AppendUtf8(buffer, code_point);
+			}
+			break;
+		default:
+			buffer += c;
+			break;
+		}
+		start = i;
+	}
+	buffer.append(value.data() + start, value.size() - start);
+}
+
+bool McpJsonReader::Equals(const McpJsonToken& token, std::string_view value)
+{
+	if (token.type != MCP_JSON_TYPE_STRING)
+	{
+		return false;
+	}
+
+	if (!HasEscape(token))
+	{
+		return GetStringContent(token) == value;
+	}
+
+	std::string unescaped;
+	AppendUnescaped(unescaped, token);
+	return unescaped == value;
+}
+
+bool McpJsonReader::IsNumber(std::string_view value)
+{
+	size_t pos = 0;
+	return ParseNumber(value, pos) && pos == value.size();
+}
+
+bool McpJsonReader::ParseValue(std::string_view json, size_t& pos, McpJsonToken& token, int depth)
+{
+	if (pos >= json.size() || depth > MAX_DEPTH)
+	{
+		return false;
+	}
+
+	size_t start = pos;
+	switch (json[pos])
+	{
+	case '"':
+		token.type = MCP_JSON_TYPE_STRING;
+		if (!ParseString(json, pos))
+		{
+			return false;
+		}
+		break;
+	case '{':
+		token.type = MCP_JSON_TYPE_OBJECT;
+		pos++;
+		SkipSpace(json, pos);
+		if (pos < json.size() && json[pos] == '}')
+		{
+			pos++;
+			break;
+		}
+		while (true)
+		{
+			McpJsonToken member;
+			if (pos >= json.size() || json[pos] != '"' || !ParseValue(json, pos, member, depth + 1))
+			{
+				return false;
+			}
+			SkipSpace(json, pos);
+			if (pos >= json.size() || json[pos] != ':')
+			{
+				return false;
+			}
+			pos++;
+			SkipSpace(json, pos);
+			if (!ParseValue(json, pos, member, depth + 1))
+			{
+				return false;
+			}
+			SkipSpace(json, pos);
+			if (pos >= json.size())
+			{
+				return false;
+			}
+			if (json[pos] == '}')
+			{
+				pos++;
+				break;
+			}
+			if (json[pos] != ',')
+			{
+				return false;
+			}
+			pos++;
+			SkipSpace(json, pos);
+		}
+		break;
+	case '[':
+		token.type = MCP_JSON_TYPE_ARRAY;
+		pos++;
+		SkipSpace(json, pos);
+		if (pos < json.size() && json[pos] == ']')
+		{
+			pos++;
+			break;
+		}
+		while (true)
+		{
+			McpJsonToken element;
+			if (!ParseValue(json, pos, element, depth + 1))
+			{
+				return false;
+			}
+			SkipSpace(json, pos);
+			if (pos >= json.size())
+			{
+				return false;
+			}
+			if (json[pos] == ']')
+			{
+				pos++;
+				break;
+			}
+			if (json[pos] != ',')
+			{
+				return false;
+			}
+			pos++;
+			SkipSpace(json, pos);
+		}
+		break;
+	case 't':
+		token.type = MCP_JSON_TYPE_BOOLEAN;
+		if (!ParseLiteral(json, pos, "true"))
+		{
+			return false;
+		}
+		break;
+	case 'f':
+		token.type = MCP_JSON_TYPE_BOOLEAN;
+		if (!ParseLiteral(json, pos, "false"))
+		{
+			return false;
+		}
+		break;
+	case 'n':
+		token.type = MCP_JSON_TYPE_NULL;
+		if (!ParseLiteral(json, pos, "null"))
+		{
+			return false;
+		}
+		break;
+	default:
+		token.type = MCP_JSON_TYPE_NUMBER;
+		if (!ParseNumber(json, pos))
+		{
+			return false;
+		}
+		break;
+	}
+
+	token.raw = json.substr(start, pos - start);
+
+	return true;
+}
+
+bool McpJsonReader::ParseString(std::string_view json, size_t& pos)
+{
+	pos++;
+	while (pos < json.size())
+	{
+		unsigned char c = (unsigned char)json[pos];
+		if (c == '"')
+		{
+			pos++;
+			return true;
+		}
+		if (c < 0x20)
+		{
+			return false;
+		}
+		if (c == '\\')
+		{
+			pos++;
+			if (pos >= json.size())
+			{
+				return false;
+			}
+			switch (json[pos])
+			{
+			case '"':
+			case '\\':
+			case '/':
+			case 'b':
+			case 'f':
+			case 'n':
+			case 'r':
+			case 't':
+				break;
+			case 'u':
+				if (pos + 4 >= json.size())
+				{
+					return false;
+				}
+				for (size_t i = 1; i <= 4; i++)
+				{
+					if (HexValue(json[pos + i]) < 0)
+					{
+						return false;
+					}
+				}
+				pos += 4;
+				break;
+			default:
+				return false;
+			}
+		}
+		pos++;
+	}
+
+	return false;
+}
+
+bool McpJsonReader::ParseNumber(std::string_view json, size_t& pos)
+{
+	size_t start = pos;
+
+	if (pos < json.size() && json[pos] == '-')
+	{
+		pos++;
+	}
+
+	if (pos < json.size() && json[pos] == '0')
+	{
+		pos++;
+	}
+	else if (pos < json.size() && json[pos] >= '1' && json[pos] <= '9')
+	{
+		while (pos < json.size() && json[pos] >= '0' && json[pos] <= '9')
+		{
+			pos++;
+		}
+	}
+	else
+	{
+		return false;
+	}
+
+	if (pos < json.size() && json[pos] == '.')
+	{
+		pos++;
+		if (pos >= json.size() || json[pos] < '0' || json[pos] > '9')
+		{
+			return false;
+		}
+		while (pos < json.size() && json[pos] >= '0' && json[pos] <= '9')
+		{
+			pos++;
+		}
+	}
+
+	if (pos < json.size() && (json[pos] == 'e' || json[pos] == 'E'))
+	{
+		pos++;
+		if (pos < json.size() && (json[pos] == '+' || json[pos] == '-'))
+		{
+			pos++;
+		}
+		if (pos >= json.size() || json[pos] < '0' || json[pos] > '9')
+		{
+			return false;
+		}
+		while (pos < json.size() && json[pos] >= '0' && json[pos] <= '9')
+		{
+			pos++;
+		}
+	}
+
+	return pos > start;
+}
+
+bool McpJsonReader::ParseLiteral(std::string_view json, size_t& pos, std::string_view literal)
+{
+	if (json.substr(pos, literal.size()) != literal)
+	{
+		return false;
+	}
+
+	pos += literal.size();
+	return true;
+}
+
+void McpJsonReader::SkipSpace(std::string_view json, size_t& pos)
+{
+	while (pos < json.size() && (json[pos] == ' ' || json[pos] == '\t' || json[pos] == '\n' || json[pos] == '\r'))
+	{
+		pos++;
+	}
+}
+
+}
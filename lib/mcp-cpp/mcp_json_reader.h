@@ -0,0 +1,159 @@
+/*
+ *  Copyright (C) 2025 UmeSoftware LLC
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <string>
+#include <string_view>
+
+namespace Mcp {
+
+enum McpJsonType {
+	MCP_JSON_TYPE_INVALID = -1,
+	MCP_JSON_TYPE_NULL = 0,
+	MCP_JSON_TYPE_BOOLEAN,
+	MCP_JSON_TYPE_NUMBER,
+	MCP_JSON_TYPE_STRING,
+	MCP_JSON_TYPE_OBJECT,
+	MCP_JSON_TYPE_ARRAY
+};
+
+struct McpJsonToken {
+	McpJsonType type = MCP_JSON_TYPE_INVALID;
+	std::string_view raw;	// the value as it appears in the input, quotes included for strings
+};
+
+// Allocation-free JSON scanner. Tokens are views into the scanned text,
+// which must outlive them.
+class McpJsonReader
+{
+public:
+	// Validates |json| as exactly one JSON value surrounded by optional whitespace.
+	static bool Parse(std::string_view json, McpJsonToken& token);
+
+	// Calls callback(key, value) for every member of an object token, with |key| still
+	// quoted and escaped. Stops early and returns false when the callback returns false.
+	template <typename Callback>
+	static bool ForEachMember(const McpJsonToken& object, Callback callback);
+
+	// Calls callback(value) for every element of an array token.
+	template <typename Callback>
+	static bool ForEachElement(const McpJsonToken& array, Callback callback);
+
+	// Content of a string token without the quotes. Escape sequences are left as is.
+	static std::string_view GetStringContent(const McpJsonToken& token);
+	static bool HasEscape(const McpJsonToken& token);
+	static void AppendUnescaped(std::string& buffer, const McpJsonToken& token);
+	static bool Equals(const McpJsonToken& token, std::string_view value);
+
+	// Whether |value| is exactly one JSON number.
+	static bool IsNumber(std::string_view value);
+
+private:
+	static bool ParseValue(std::string_view json, size_t& pos, McpJsonToken& token, int depth);
+	static bool ParseString(std::string_view json, size_t& pos);
+	static bool ParseNumber(std::string_view json, size_t& pos);
+	static bool ParseLiteral(std::string_view json, size_t& pos, std::string_view literal);
+	static void SkipSpace(std::string_view json, size_t& pos);
+};
+
+template <typename Callback>
+bool McpJsonReader::ForEachMember(const McpJsonToken& object, Callback callback)
+{
+	if (object.type != MCP_JSON_TYPE_OBJECT)
+	{
+		return false;
+	}
+
+	// The token has already been validated, so only the layout needs walking.
+	std::string_view json = object.raw;
+	size_t pos = 1;
+
+	SkipSpace(json, pos);
+	if (json[pos] == '}')
+	{
+		return true;
+	}
+
+	while (pos < json.size())
+	{
+		McpJsonToken key;
+		ParseValue(json, pos, key, 0);
+		SkipSpace(json, pos);
+		pos++;	// ':'
+
+		McpJsonToken value;
+		SkipSpace(json, pos);
+		ParseValue(json, pos, value, 0);
+
+		if (!callback(key, value))
+		{
+			return false;
+		}
+
+		SkipSpace(json, pos);
+		if (json[pos] == '}')
+		{
+			break;
+		}
+		pos++;	// ','
+		SkipSpace(json, pos);
+	}
+
+	return true;
+}
+
+template <typename Callback>
+bool McpJsonReader::ForEachElement(const McpJsonToken& array, Callback callback)
+{
+	if (array.type != MCP_JSON_TYPE_ARRAY)
+	{
+		return false;
+	}
+
+	std::string_view json = array.raw;
+	size_t pos = 1;
+
+	SkipSpace(json, pos);
+	if (json[pos] == ']')
+	{
+		return true;
+	}
+
+	while (pos < json.size())
+	{
+		McpJsonToken value;
+		ParseValue(json, pos, value, 0);
+
+		if (!callback(value))
+		{
+			return false;
+		}
+
+		SkipSpace(json, pos);
+		if (json[pos] == ']')
+		{
+			break;
+		}
+		pos++;	// ','
+		SkipSpace(json, pos);
+	}
+
+	return true;
+}
+
+}
@@ -0,0 +1,139 @@
+/*
+ *  Copyright (C) 2025 UmeSoftware LLC
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "mcp_json_writer.h"
+
+#include <charconv>
+#include <cmath>
+
+namespace Mcp {
+
+static thread_local std::string s_buffer;
+
+McpJsonWriter::McpJsonWriter()
+	: m_buffer(s_buffer)
+{
+	m_buffer.clear();
+}
+
+void McpJsonWriter::BeginResult(std::string_view id)
+{
+	m_buffer += "{\"jsonrpc\":\"2.0\",\"id\":";
+	m_buffer += id.empty() ? "null" : id;
+	m_buffer += ",\"result\":";
+}
+
+void McpJsonWriter::BeginError(std::string_view id)
+{
+	m_buffer += "{\"jsonrpc\":\"2.0\",\"id\":";
+	m_buffer += id.empty() ? "null" : id;
+	m_buffer += ",\"error\":";
+}
+
+void McpJsonWriter::BeginNotification(std::string_view method)
+{
+	m_buffer += "{\"jsonrpc\":\"2.0\",\"method\":";
+	AppendString(method);
+	m_buffer += ",\"params\":";
+}
+
+void McpJsonWriter::End()
+{
+	m_buffer += '}';
+}
+
+void McpJsonWriter::AppendRaw(std::string_view value)
+{
+	m_buffer += value;
+}
+
+void McpJsonWriter::AppendString(std::string_view value)
+{
+	m_buffer += '"';
+	AppendEscaped(m_buffer, value);
+	m_buffer += '"';
+}
+
+void McpJsonWriter::AppendInt(long long value)
+{
+	m_buffer += std::to_string(value);
+}
+
+void McpJsonWriter::AppendDouble(double value)
+{
+	if (!std::isfinite(value))
+	{
+		m_buffer += "null";
+		return;
+	}
+
+	// Shortest form that reads back as the same value, independent of the locale.
+	char value_str[32];
+	auto result = std::to_chars(value_str, value_str + sizeof(value_str), value);
+	m_buffer.append(value_str, result.ptr - value_str);
+}
+
+void McpJsonWriter::AppendEscaped(std::string& buffer, std::string_view value)
+{
+	static const char hex[] = "0123456789abcdef";
+
+	size_t start = 0;
+	for (size_t i = 0; i < value.size(); i++)
+	{
+		unsigned char c = (unsigned char)value[i];
+		if (c >= 0x20 && c != '"' && c != '\\')
+		{
+			continue;
+		}
+
+		buffer.append(value.data() + start, i - start);
+		start = i + 1;
+
+		switch (c)
+		{
+		case '"':
+			buffer += "\\\"";
+			break;
+		case '\\':
+			buffer += "\\\\";
+			break;
+		case '\b':
+			buffer += "\\b";
+			break;
+		case '\f':
+			buffer += "\\f";
+			break;
+		case '\n':
+			buffer += "\\n";
+			break;
+		case '\r':
+			buffer += "\\r";
+			break;
+		case '\t':
+			buffer += "\\t";
+			break;
+		default:
+			buffer += "\\u00";
+			buffer += hex[c >> 4];
+			buffer += hex[c & 0x0f];
+			break;
+		}
+	}
+	buffer.append(value.data() + start, value.size() - start);
+}
+
+}
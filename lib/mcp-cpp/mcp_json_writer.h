@@ -0,0 +1,50 @@
+/*
+ *  Copyright (C) 2025 UmeSoftware LLC
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <string>
+#include <string_view>
+
+namespace Mcp {
+
+// Writes outgoing JSON-RPC messages straight into a per-thread buffer that keeps its
+// capacity between messages. Only one writer may be in use on a thread at a time.
+class McpJsonWriter
+{
+public:
+	McpJsonWriter();
+
+	void BeginResult(std::string_view id);
+	void BeginError(std::string_view id);
+	void BeginNotification(std::string_view method);
+	void End();
+
+	void AppendRaw(std::string_view value);
+	void AppendString(std::string_view value);
+	void AppendInt(long long value);
+	void AppendDouble(double value);
+
+	const std::string& GetString() const { return m_buffer; }
+
+	static void AppendEscaped(std::string& buffer, std::string_view value);
+
+private:
+	std::string& m_buffer;
+};
+
+}
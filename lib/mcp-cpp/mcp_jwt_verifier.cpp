@@ -0,0 +1,491 @@
+/*
+ *  Copyright (C) 2025 UmeSoftware LLC
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "mcp_jwt_verifier.h"
+#include "mcp_logger.h"
+
+#include <curl/curl.h>
+#include <openssl/evp.h>
+
+namespace Mcp {
+
+static const size_t MAX_VERIFIED_TOKENS = 4096;
+static const std::chrono::seconds MIN_REFRESH_INTERVAL(5);	// against tokens with made-up key ids
+static const std::chrono::seconds MAX_TOKEN_LIFETIME(3600);	// how long a verified token is remembered at most
+static const size_t CLOCK_LEEWAY = 60;	// seconds
+static const long FETCH_TIMEOUT = 10;	// seconds
+
+static size_t WriteCallback(char* ptr, size_t size, size_t nmemb, void* userdata)
+{
+	((std::string*)userdata)->append(ptr, size * nmemb);
+	return size * nmemb;
+}
+
+static int AbortCallback(void* clientp, curl_off_t, curl_off_t, curl_off_t, curl_off_t)
+{
+	return *(const std::atomic<bool>*)clientp ? 1 : 0;
+}
+
+static bool HttpGetJson(const std::string& url, nlohmann::json& response, const std::atomic<bool>& is_aborted)
+{
+	CURL* curl = curl_easy_init();
+	if (curl == nullptr)
+	{
+		return false;
+	}
+
+	std::string response_data;
+	curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, WriteCallback);
+	curl_easy_setopt(curl, CURLOPT_WRITEDATA, &response_data);
+
+	curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
+	curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1L);
+	curl_easy_setopt(curl, CURLOPT_TIMEOUT, FETCH_TIMEOUT);
+	curl_easy_setopt(curl, CURLOPT_NOSIGNAL, 1L);
+	curl_easy_setopt(curl, CURLOPT_XFERINFOFUNCTION, AbortCallback);
+	curl_easy_setopt(curl, CURLOPT_XFERINFODATA, &is_aborted);
+	curl_easy_setopt(curl, CURLOPT_NOPROGRESS, 0L);
+
+	long http_code = 0;
+	CURLcode res = curl_easy_perform(curl);
+	if (res == CURLE_OK)
+	{
+		curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &http_code);
+	}
+	curl_easy_cleanup(curl);
+
+	if (http_code != 200)
+	{
+		MCP_LOG_DEBUG("cannot get %s: %s", url.c_str(), res == CURLE_OK ? std::to_string(http_code).c_str() : curl_easy_strerror(res));
+		return false;
+	}
+
+	response = nlohmann::json::parse(response_data, nullptr, false);
+	return response.is_object();
+}
+
+McpJwtVerifier::McpJwtVerifier(const std::string& authorization_servers, const std::string& audience)
+	: m_audience(audience)
+	, m_refreshed_at(std::chrono::steady_clock::now() - MIN_REFRESH_INTERVAL)
+	, m_is_refreshing(true)
+	, m_is_stopping(false)
+{
+	// The servers are configured as the JSON array items of the resource metadata.
+	nlohmann::json servers = nlohmann::json::parse("[" + authorization_servers + "]", nullptr, false);
+	if (servers.is_array())
+	{
+		for (auto it = servers.begin(); it != servers.end(); it++)
+		{
+			if (it->is_string())
+			{
+				m_authorization_servers.push_back(it->get<std::string>());
+			}
+		}
+	}
+	else
+	{
+		m_authorization_servers.push_back(authorization_servers);
+	}
+
+	// Before any thread of ours uses curl, since the implicit init in curl_easy_init is not thread-safe.
+	curl_global_init(CURL_GLOBAL_DEFAULT);
+
+	m_refresh_thread = std::make_unique<std::thread>(&McpJwtVerifier::ProcRefresh, this);
+}
+
+McpJwtVerifier::~McpJwtVerifier()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_key_mutex);
+
+		m_is_stopping = true;
+	}
+	m_refresh_cv.notify_one();
+	m_refresh_thread->join();
+
+	curl_global_cleanup();
+}
+
+McpJwtResult McpJwtVerifier::Verify(const std::string& token)
+{
+	std::string hash = HashToken(token);
+	if (FindToken(hash))
+	{
+		return MCP_JWT_OK;
+	}
+
+	std::chrono::system_clock::time_point expires;
+	try
+	{
+		auto decoded = jwt::decode(token);
+		if (!decoded.has_expires_at() || !decoded.has_issuer())
+		{
+			MCP_LOG_DEBUG("rejected bearer token without exp or iss");
+			return MCP_JWT_INVALID;
+		}
+		expires = std::min(std::chrono::system_clock::now() + MAX_TOKEN_LIFETIME, decoded.get_expires_at());
+
+		std::string issuer = decoded.get_issuer();
+		std::shared_ptr<const Verifier> verifier;
+		{
+			std::lock_guard<std::mutex> lock(m_key_mutex);
+
+			if (decoded.has_key_id())
+			{
+				auto it = m_keys.find(KeyId(issuer, decoded.get_key_id()));
+				if (it != m_keys.end())
+				{
+					verifier = it->second;
+				}
+			}
+			else
+			{
+				// Trying every key of the issuer would let one token cost many signature checks.
+				auto it = m_keys.lower_bound(KeyId(issuer, ""));
+				if (it != m_keys.end() && it->first.first == issuer)
+				{
+					auto next = std::next(it);
+					if (next != m_keys.end() && next->first.first == issuer)
+					{
+						MCP_LOG_DEBUG("rejected bearer token without kid from %s, which has several keys", issuer.c_str());
+						return MCP_JWT_INVALID;
+					}
+					verifier = it->second;
+				}
+			}
+		}
+
+		if (!verifier)
+		{
+			// The server may have rotated in a new key since the last fetch.
+			return StartRefresh() ? MCP_JWT_PENDING : MCP_JWT_INVALID;
+		}
+
+		std::error_code ec;
+		verifier->verify(decoded, ec);
+		if (ec)
+		{
+			MCP_LOG_DEBUG("rejected bearer token: %s", ec.message().c_str());
+			if (ec == jwt::error::token_verification_error::audience_missmatch)
+			{
+				return MCP_JWT_FORBIDDEN;
+			}
+			return MCP_JWT_INVALID;
+		}
+	}
+	catch (std::exception& ex)
+	{
+		MCP_LOG_DEBUG("malformed bearer token: %s", ex.what());
+		return MCP_JWT_MALFORMED;
+	}
+
+	PutToken(hash, expires);
+	return MCP_JWT_OK;
+}
+
+// Returns whether the keys may still change, that is a fetch is running or was just requested.
+bool McpJwtVerifier::StartRefresh()
+{
+	std::lock_guard<std::mutex> lock(m_key_mutex);
+
+	if (m_is_refreshing)
+	{
+		return true;
+	}
+	if (std::chrono::steady_clock::now() - m_refreshed_at < MIN_REFRESH_INTERVAL)
+	{
+		return false;
+	}
+
+	m_is_refreshing = true;
+	m_refresh_cv.notify_one();
+
+	return true;
+}
+
+void McpJwtVerifier::ProcRefresh()
+{
+	std::unique_lock<std::mutex> lock(m_key_mutex);
+
+	while (true)
+	{
+		m_refresh_cv.wait(lock, [this] { return m_is_refreshing || m_is_stopping; });
+		if (m_is_stopping)
+		{
+			break;
+		}
+
+		lock.unlock();
+		Refresh();
+		lock.lock();
+	}
+}
+
+void McpJwtVerifier::Refresh()
+{
+	KeyMap keys;
+	size_t fetched_count = 0;
+	for (auto it = m_authorization_servers.begin(); it != m_authorization_servers.end() && !m_is_stopping; it++)
+	{
+		if (FetchKeys(*it, keys))
+		{
+			fetched_count++;
+		}
+	}
+
+	bool is_revoked = false;
+	{
+		std::lock_guard<std::mutex> lock(m_key_mutex);
+
+		if (fetched_count == m_authorization_servers.size())
+		{
+			// Tokens verified with a key that is gone must be verified again.
+			for (auto it = m_keys.begin(); it != m_keys.end(); it++)
+			{
+				is_revoked = is_revoked || keys.find(it->first) == keys.end();
+			}
+			m_keys.swap(keys);
+		}
+		else
+		{
+			// Keep the keys of the servers that could not be reached.
+			for (auto it = keys.begin(); it != keys.end(); it++)
+			{
+				m_keys[it->first] = it->second;
+			}
+			MCP_LOG_WARNING("cannot fetch the signing keys of %zu authorization servers", m_authorization_servers.size() - fetched_count);
+		}
+		MCP_LOG_INFO("loaded %zu signing keys", m_keys.size());
+
+		m_refreshed_at = std::chrono::steady_clock::now();
+		m_is_refreshing = false;
+	}
+
+	if (is_revoked)
+	{
+		ClearTokens();
+	}
+}
+
+bool McpJwtVerifier::FetchKeys(const std::string& authorization_server, KeyMap& keys)
+{
+	std::string base_url = authorization_server;
+	if (!base_url.empty() && base_url.back() == '/')
+	{
+		base_url.pop_back();
+	}
+
+	nlohmann::json metadata;
+	if (!HttpGetJson(base_url + "/.well-known/oauth-authorization-server", metadata, m_is_stopping) &&
+		!HttpGetJson(base_url + "/.well-known/openid-configuration", metadata, m_is_stopping))
+	{
+		return false;
+	}
+
+	// RFC 8414 requires the issuer to be the server's identifier, which stands in when it is missing.
+	auto jwks_uri = metadata.find("jwks_uri");
+	std::string issuer = authorization_server;
+	auto issuer_value = metadata.find("issuer");
+	if (issuer_value != metadata.end() && issuer_value->is_string())
+	{
+		issuer = issuer_value->get<std::string>();
+	}
+	nlohmann::json jwks;
+	if (jwks_uri == metadata.end() || !jwks_uri->is_string() || !HttpGetJson(jwks_uri->get<std::string>(), jwks, m_is_stopping))
+	{
+		return false;
+	}
+
+	auto jwk_keys = jwks.find("keys");
+	if (jwk_keys == jwks.end() || !jwk_keys->is_array())
+	{
+		return false;
+	}
+
+	for (auto it = jwk_keys->begin(); it != jwk_keys->end(); it++)
+	{
+		if (!it->is_object())
+		{
+			continue;
+		}
+
+		// Members of the wrong type throw, which skips only this key.
+		std::string key_id;
+		try
+		{
+			if (it->value("use", "sig") != "sig")
+			{
+				continue;
+			}
+
+			key_id = it->value("kid", "");
+			std::string key_type = it->value("kty", "");
+			std::string algorithm = it->value("alg", "");
+
+			// The algorithm is pinned per key, so a token cannot pick a weaker one.
+			std::string public_key;
+			if (key_type == "RSA")
+			{
+				public_key = jwt::helper::create_public_key_from_rsa_components(it->value("n", ""), it->value("e", ""));
+				if (algorithm.empty())
+				{
+					algorithm = "RS256";
+				}
+			}
+			else if (key_type == "EC")
+			{
+				std::string curve = it->value("crv", "");
+				public_key = jwt::helper::create_public_key_from_ec_components(curve, it->value("x", ""), it->value("y", ""));
+				if (algorithm.empty())
+				{
+					algorithm = curve == "P-384" ? "ES384" : curve == "P-521" ? "ES512" : "ES256";
+				}
+			}
+			else
+			{
+				continue;
+			}
+
+			Verifier verifier = jwt::verify().with_audience(m_audience).with_issuer(issuer).leeway(CLOCK_LEEWAY);
+			if (!AllowAlgorithm(verifier, algorithm, public_key))
+			{
+				MCP_LOG_DEBUG("skipped key %s with algorithm %s", key_id.c_str(), algorithm.c_str());
+				continue;
+			}
+
+			keys[KeyId(issuer, key_id)] = std::make_shared<const Verifier>(std::move(verifier));
+		}
+		catch (std::exception& ex)
+		{
+			MCP_LOG_WARNING("skipped key %s of %s: %s", key_id.c_str(), authorization_server.c_str(), ex.what());
+		}
+	}
+
+	return true;
+}
+
+bool McpJwtVerifier::AllowAlgorithm(Verifier& verifier, const std::string& algorithm, const std::string& public_key)
+{
+	if (algorithm == "RS256")
+	{
+		verifier.allow_algorithm(jwt::algorithm::rs256(public_key));
+	}
+	else if (algorithm == "RS384")
+	{
+		verifier.allow_algorithm(jwt::algorithm::rs384(public_key));
+	}
+	else if (algorithm == "RS512")
+	{
+		verifier.allow_algorithm(jwt::algorithm::rs512(public_key));
+	}
+	else if (algorithm == "PS256")
+	{
+		verifier.allow_algorithm(jwt::algorithm::ps256(public_key));
+	}
+	else if (algorithm == "PS384")
+	{
+		verifier.allow_algorithm(jwt::algorithm::ps384(public_key));
+	}
+	else if (algorithm == "PS512")
+	{
+		verifier.allow_algorithm(jwt::algorithm::ps512(public_key));
+	}
+	else if (algorithm == "ES256")
+	{
+		verifier.allow_algorithm(jwt::algorithm::es256(public_key));
+	}
+	else if (algorithm == "ES384")
+	{
+		verifier.allow_algorithm(jwt::algorithm::es384(public_key));
+	}
+	else if (algorithm == "ES512")
+	{
+		verifier.allow_algorithm(jwt::algorithm::es512(public_key));
+	}
+	else
+	{
+		return false;
+	}
+
+	return true;
+}
+
+std::string McpJwtVerifier::HashToken(const std::string& token)
+{
+	unsigned char digest[EVP_MAX_MD_SIZE];
+	unsigned int digest_len = 0;
+	EVP_Digest(token.data(), token.size(), digest, &digest_len, EVP_sha256(), nullptr);
+
+	return std::string((const char*)digest, digest_len);
+}
+
+bool McpJwtVerifier::FindToken(const std::string& hash)
+{
+	std::lock_guard<std::mutex> lock(m_token_mutex);
+
+	auto it = m_token_index.find(hash);
+	if (it == m_token_index.end())
+	{
+		return false;
+	}
+
+	if (it->second->expires <= std::chrono::system_clock::now())
+	{
+		m_tokens.erase(it->second);
+		m_token_index.erase(it);
+		return false;
+	}
+
+	m_tokens.splice(m_tokens.begin(), m_tokens, it->second);
+	return true;
+}
+
+void McpJwtVerifier::PutToken(const std::string& hash, std::chrono::system_clock::time_point expires)
+{
+	if (expires <= std::chrono::system_clock::now())
+	{
+		return;
+	}
+
+	std::lock_guard<std::mutex> lock(m_token_mutex);
+
+	auto it = m_token_index.find(hash);
+	if (it != m_token_index.end())
+	{
+		m_tokens.erase(it->second);
+		m_token_index.erase(it);
+	}
+
+	while (m_tokens.size() >= MAX_VERIFIED_TOKENS)
+	{
+		m_token_index.erase(m_tokens.back().hash);
+		m_tokens.pop_back();
+	}
+
+	m_tokens.push_front({ hash, expires });
+	m_token_index[hash] = m_tokens.begin();
+}
+
+void McpJwtVerifier::ClearTokens()
+{
+	std::lock_guard<std::mutex> lock(m_token_mutex);
+
+	m_tokens.clear();
+	m_token_index.clear();
+}
+
+}
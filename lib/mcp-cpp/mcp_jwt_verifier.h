@@ -0,0 +1,88 @@
+/*
+ *  Copyright (C) 2025 UmeSoftware LLC
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "mcp-cpp/mcp_type.h"
+#include "jwt-cpp/jwt.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <list>
+#include <unordered_map>
+
+namespace Mcp {
+
+enum McpJwtResult {
+	MCP_JWT_OK,
+	MCP_JWT_MALFORMED,	// not a JWT
+	MCP_JWT_INVALID,	// bad signature, unknown key, expired, without exp or wrong issuer
+	MCP_JWT_FORBIDDEN,	// issued for another resource
+	MCP_JWT_PENDING,	// signed with a key that is being fetched, retry later
+};
+
+// Verifies bearer tokens against the JWKS of the authorization servers. Keys are fetched
+// in the background, once at start and again when a token names an unknown key id.
+// A token is checked only against the key its issuer and key id name; one without a key
+// id is accepted only from an issuer with a single key. Verified tokens are remembered by
+// their hash until they expire.
+class McpJwtVerifier
+{
+public:
+	McpJwtVerifier(const std::string& authorization_servers, const std::string& audience);
+	~McpJwtVerifier();
+
+	McpJwtResult Verify(const std::string& token);
+
+private:
+	typedef jwt::verifier<jwt::default_clock, jwt::traits::kazuho_picojson> Verifier;
+
+	std::vector<std::string> m_authorization_servers;
+	std::string m_audience;
+
+	typedef std::pair<std::string, std::string> KeyId;	// issuer, key id
+	typedef std::map<KeyId, std::shared_ptr<const Verifier>> KeyMap;
+
+	KeyMap m_keys;
+	std::chrono::steady_clock::time_point m_refreshed_at;
+	bool m_is_refreshing;	// a fetch is requested or running
+	std::atomic<bool> m_is_stopping;	// also aborts a running fetch
+	std::unique_ptr<std::thread> m_refresh_thread;
+	std::condition_variable m_refresh_cv;
+	std::mutex m_key_mutex;
+
+	bool StartRefresh();
+	void ProcRefresh();
+	void Refresh();
+	bool FetchKeys(const std::string& authorization_server, KeyMap& keys);
+	static bool AllowAlgorithm(Verifier& verifier, const std::string& algorithm, const std::string& public_key);
+
+	struct TokenEntry {
+		std::string hash;
+		std::chrono::system_clock::time_point expires;
+	};
+	std::list<TokenEntry> m_tokens;	// most recently used first
+	std::unordered_map<std::string, std::list<TokenEntry>::iterator> m_token_index;
+	std::mutex m_token_mutex;
+
+	static std::string HashToken(const std::string& token);
+	bool FindToken(const std::string& hash);
+	void PutToken(const std::string& hash, std::chrono::system_clock::time_point expires);
+	void ClearTokens();
+};
+
+}
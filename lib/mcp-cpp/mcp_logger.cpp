@@ -0,0 +1,236 @@
+/*
+ *  Copyright (C) 2025 UmeSoftware LLC
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "mcp_logger.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+namespace Mcp {
+
+std::atomic<McpLogLevel> McpLogger::s_level(MCP_LOG_LEVEL_WARNING);
+
+void SetMcpLogLevel(McpLogLevel level)
+{
+	McpLogger::SetLevel(level);
+}
+
+// Bounded multi-producer queue after Dmitry Vyukov. Each slot's sequence number
+// tells producers and the writer thread whose turn it is.
+class McpLogRing
+{
+public:
+	McpLogRing()
+		: m_enqueue_pos(0)
+		, m_dequeue_pos(0)
+		, m_dropped(0)
+		, m_is_waiting(false)
+	{
+		for (size_t i = 0; i < CAPACITY; i++)
+		{
+			m_records[i].sequence.store(i, std::memory_order_relaxed);
+		}
+
+		std::thread([this] { Run(); }).detach();
+	}
+
+	void Write(McpLogLevel level, const char* format, va_list args)
+	{
+		size_t pos = m_enqueue_pos.load(std::memory_order_relaxed);
+		Record* record;
+		while (true)
+		{
+			record = &m_records[pos % CAPACITY];
+			size_t sequence = record->sequence.load(std::memory_order_acquire);
+			if (sequence == pos)
+			{
+				if (m_enqueue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+				{
+					break;
+				}
+			}
+			else if (sequence < pos)
+			{
+				m_dropped++;
+				Wake();
+				return;
+			}
+			else
+			{
+				pos = m_enqueue_pos.load(std::memory_order_relaxed);
+			}
+		}
+
+		record->level = level;
+		record->time = std::chrono::system_clock::now();
+
+		int length = vsnprintf(record->message, sizeof(record->message), format, args);
+		if (length >= (int)sizeof(record->message))
+		{
+			memcpy(record->message + sizeof(record->message) - sizeof(TRUNCATED), TRUNCATED, sizeof(TRUNCATED));
+		}
+
+		record->sequence.store(pos + 1, std::memory_order_release);
+		Wake();
+	}
+
+	bool Flush()
+	{
+		std::lock_guard<std::mutex> lock(m_flush_mutex);
+
+		bool has_written = false;
+		while (true)
+		{
+			Record& record = m_records[m_dequeue_pos % CAPACITY];
+			if (record.sequence.load(std::memory_order_acquire) != m_dequeue_pos + 1)
+			{
+				break;
+			}
+
+			auto since_epoch = record.time.time_since_epoch();
+			time_t seconds = (time_t)std::chrono::duration_cast<std::chrono::seconds>(since_epoch).count();
+			int milliseconds = (int)(std::chrono::duration_cast<std::chrono::milliseconds>(since_epoch).count() % 1000);
+
+			struct tm tm_info;
+#ifdef _WIN32
+			gmtime_s(&tm_info, &seconds);
+#else
+			gmtime_r(&seconds, &tm_info);
+#endif
+			char time_str[32];
+			strftime(time_str, sizeof(time_str), "%Y-%m-%dT%H:%M:%S", &tm_info);
+
+			fprintf(stderr, "%s.%03dZ [%s] %s\n", time_str, milliseconds, McpLogLevelToString(record.level).c_str(), record.message);
+
+			record.sequence.store(m_dequeue_pos + CAPACITY, std::memory_order_release);
+			m_dequeue_pos++;
+			has_written = true;
+		}
+
+		size_t dropped = m_dropped.exchange(0);
+		if (dropped > 0)
+		{
+			fprintf(stderr, "[warning] %zu log records dropped\n", dropped);
+			has_written = true;
+		}
+
+		if (has_written)
+		{
+			fflush(stderr);
+		}
+		return has_written;
+	}
+
+private:
+	static const size_t CAPACITY = 1024;
+	static constexpr char TRUNCATED[] = "...";
+
+	struct Record {
+		std::atomic<size_t> sequence;
+		McpLogLevel level;
+		std::chrono::system_clock::time_point time;
+		char message[256];
+	};
+	Record m_records[CAPACITY];
+
+	std::atomic<size_t> m_enqueue_pos;
+	size_t m_dequeue_pos;
+	std::atomic<size_t> m_dropped;
+	std::mutex m_flush_mutex;
+
+	std::atomic<bool> m_is_waiting;
+	std::mutex m_wait_mutex;
+	std::condition_variable m_wait_cv;
+
+	// Pairs with the fence in Run, so either the writer sees the new record or we see it waiting.
+	void Wake()
+	{
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		if (m_is_waiting.load(std::memory_order_relaxed))
+		{
+			std::lock_guard<std::mutex> lock(m_wait_mutex);
+			m_wait_cv.notify_one();
+		}
+	}
+
+	bool IsPending()
+	{
+		std::lock_guard<std::mutex> lock(m_flush_mutex);
+		return m_records[m_dequeue_pos % CAPACITY].sequence.load(std::memory_order_acquire) == m_dequeue_pos + 1 ||
+			m_dropped.load(std::memory_order_relaxed) > 0;
+	}
+
+	void Run()
+	{
+		while (true)
+		{
+			if (Flush())
+			{
+				continue;
+			}
+
+			std::unique_lock<std::mutex> lock(m_wait_mutex);
+			m_is_waiting.store(true, std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			m_wait_cv.wait(lock, [this] { return IsPending(); });
+			m_is_waiting.store(false, std::memory_order_relaxed);
+		}
+	}
+};
+
+// Set once exit starts; the writer thread may not get to run again, so callers write their own records.
+static std::atomic<bool> s_is_exiting(false);
+
+// Never destroyed: the writer thread outlives every static, and exit flushes what is left.
+static McpLogRing& GetLogRing()
+{
+	static McpLogRing* s_ring = []
+	{
+		McpLogRing* ring = new McpLogRing();
+		atexit([]
+		{
+			s_is_exiting = true;
+			McpLogger::Flush();
+		});
+		return ring;
+	}();
+	return *s_ring;
+}
+
+void McpLogger::Write(McpLogLevel level, const char* format, ...)
+{
+	McpLogRing& ring = GetLogRing();
+
+	va_list args;
+	va_start(args, format);
+	ring.Write(level, format, args);
+	va_end(args);
+
+	if (s_is_exiting)
+	{
+		ring.Flush();
+	}
+}
+
+void McpLogger::Flush()
+{
+	GetLogRing().Flush();
+}
+
+}
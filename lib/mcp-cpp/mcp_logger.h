@@ -0,0 +1,59 @@
+/*
+ *  Copyright (C) 2025 UmeSoftware LLC
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "mcp-cpp/mcp_type.h"
+
+#include <stdarg.h>
+
+namespace Mcp {
+
+// Library diagnostics. Records are formatted by the caller into a fixed ring buffer
+// without taking locks, and a background thread writes them to stderr. When the ring
+// is full, records are dropped rather than blocking the caller. The ring is never
+// destroyed, so logging from static destructors is safe.
+class McpLogger
+{
+public:
+	static bool IsEnabled(McpLogLevel level) { return level >= s_level.load(std::memory_order_relaxed); }
+	static void SetLevel(McpLogLevel level) { s_level = level; }
+
+	static void Write(McpLogLevel level, const char* format, ...)
+#if defined(__GNUC__)
+		__attribute__((format(printf, 2, 3)))
+#endif
+		;
+
+	// Writes out the records queued so far. Called when a server stops and at exit.
+	static void Flush();
+
+private:
+	static std::atomic<McpLogLevel> s_level;
+};
+
+}
+
+// The level is checked before any argument is evaluated or formatted.
+#define MCP_LOG(level, ...) \
+	do { if (Mcp::McpLogger::IsEnabled(level)) { Mcp::McpLogger::Write(level, __VA_ARGS__); } } while (0)
+
+#define MCP_LOG_DEBUG(...)		MCP_LOG(Mcp::MCP_LOG_LEVEL_DEBUG, __VA_ARGS__)
+#define MCP_LOG_INFO(...)		MCP_LOG(Mcp::MCP_LOG_LEVEL_INFO, __VA_ARGS__)
+#define MCP_LOG_NOTICE(...)		MCP_LOG(Mcp::MCP_LOG_LEVEL_NOTICE, __VA_ARGS__)
+#define MCP_LOG_WARNING(...)	MCP_LOG(Mcp::MCP_LOG_LEVEL_WARNING, __VA_ARGS__)
+#define MCP_LOG_ERROR(...)		MCP_LOG(Mcp::MCP_LOG_LEVEL_ERROR, __VA_ARGS__)
@@ -0,0 +1,140 @@
+/*
+ *  Copyright (C) 2025 UmeSoftware LLC
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "mcp_result_cache.h"
+
+namespace Mcp {
+
+static const size_t DEFAULT_MEMORY_LIMIT = 64 * 1024 * 1024;
+
+McpResultCache::McpResultCache()
+	: m_shard_memory_limit(DEFAULT_MEMORY_LIMIT / SHARD_COUNT)
+	, m_hits(0)
+	, m_misses(0)
+{
+	for (size_t i = 0; i < SHARD_COUNT; i++)
+	{
+		m_shards[i].memory_usage = 0;
+	}
+}
+
+void McpResultCache::SetMemoryLimit(size_t memory_limit)
+{
+	m_shard_memory_limit = memory_limit / SHARD_COUNT;
+}
+
+std::shared_ptr<const std::string> McpResultCache::Get(const std::string& key)
+{
+	Shard& shard = GetShard(key);
+	std::lock_guard<std::mutex> lock(shard.mutex);
+
+	auto it = shard.index.find(key);
+	if (it == shard.index.end())
+	{
+		m_misses++;
+		return nullptr;
+	}
+
+	if (it->second->expires <= std::chrono::steady_clock::now())
+	{
+		Erase(shard, it->second);
+		m_misses++;
+		return nullptr;
+	}
+
+	shard.entries.splice(shard.entries.begin(), shard.entries, it->second);
+	m_hits++;
+
+	return it->second->value;
+}
+
+void McpResultCache::Put(const std::string& key, std::string value, std::chrono::milliseconds ttl)
+{
+	Entry entry;
+	entry.key = key;
+	entry.value = std::make_shared<const std::string>(std::move(value));
+	entry.expires = std::chrono::steady_clock::now() + ttl;
+
+	size_t entry_size = GetEntrySize(entry);
+	if (entry_size > m_shard_memory_limit)
+	{
+		return;
+	}
+
+	Shard& shard = GetShard(key);
+	std::lock_guard<std::mutex> lock(shard.mutex);
+
+	auto it = shard.index.find(key);
+	if (it != shard.index.end())
+	{
+		Erase(shard, it->second);
+	}
+
+	while (!shard.entries.empty() && shard.memory_usage + entry_size > m_shard_memory_limit)
+	{
+		Erase(shard, std::prev(shard.entries.end()));
+	}
+
+	shard.entries.emplace_front(std::move(entry));
+	shard.index[key] = shard.entries.begin();
+	shard.memory_usage += entry_size;
+}
+
+size_t McpResultCache::GetEntryCount()
+{
+	size_t count = 0;
+	for (size_t i = 0; i < SHARD_COUNT; i++)
+	{
+		std::lock_guard<std::mutex> lock(m_shards[i].mutex);
+		count += m_shards[i].entries.size();
+	}
+
+	return count;
+}
+
+size_t McpResultCache::GetMemoryUsage()
+{
+	size_t memory_usage = 0;
+	for (size_t i = 0; i < SHARD_COUNT; i++)
+	{
+		std::lock_guard<std::mutex> lock(m_shards[i].mutex);
+		memory_usage += m_shards[i].memory_usage;
+	}
+
+	return memory_usage;
+}
+
+McpResultCache::Shard& McpResultCache::GetShard(const std::string& key)
+{
+	return m_shards[std::hash<std::string>()(key) % SHARD_COUNT];
+}
+
+// The key is held twice, once by the entry and once by the index.
+size_t McpResultCache::GetEntrySize(const Entry& entry)
+{
+	return entry.key.size() * 2 + entry.value->size() + sizeof(Entry) * 2;
+}
+
+// Must be called with the shard's mutex held.
+void McpResultCache::Erase(Shard& shard, std::list<Entry>::iterator it)
+{
+	shard.memory_usage -= GetEntrySize(*it);
+	shard.index.erase(it->key);
+	shard.entries.erase(it);
+}
+
+}
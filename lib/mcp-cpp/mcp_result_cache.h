@@ -0,0 +1,69 @@
+/*
+ *  Copyright (C) 2025 UmeSoftware LLC
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "mcp-cpp/mcp_type.h"
+
+#include <list>
+#include <unordered_map>
+
+namespace Mcp {
+
+// Sharded LRU of serialized tool results with a per-entry TTL and an overall byte limit.
+class McpResultCache
+{
+public:
+	McpResultCache();
+
+	void SetMemoryLimit(size_t memory_limit);
+
+	std::shared_ptr<const std::string> Get(const std::string& key);
+	void Put(const std::string& key, std::string value, std::chrono::milliseconds ttl);
+
+	size_t GetHitCount() const { return m_hits; }
+	size_t GetMissCount() const { return m_misses; }
+	size_t GetEntryCount();
+	size_t GetMemoryUsage();
+
+private:
+	static const size_t SHARD_COUNT = 16;
+
+	struct Entry {
+		std::string key;
+		std::shared_ptr<const std::string> value;
+		std::chrono::steady_clock::time_point expires;
+	};
+
+	struct Shard {
+		std::list<Entry> entries;	// most recently used first
+		std::unordered_map<std::string, std::list<Entry>::iterator> index;
+		size_t memory_usage;
+		std::mutex mutex;
+	};
+	Shard m_shards[SHARD_COUNT];
+	std::atomic<size_t> m_shard_memory_limit;
+
+	std::atomic<size_t> m_hits;
+	std::atomic<size_t> m_misses;
+
+	Shard& GetShard(const std::string& key);
+	static size_t GetEntrySize(const Entry& entry);
+	void Erase(Shard& shard, std::list<Entry>::iterator it);
+};
+
+}
@@ -16,6 +16,11 @@
  */
 
 #include "mcp_server_impl.h"
+#include "mcp_json_writer.h"
+#include "mcp_logger.h"
+
+#include <algorithm>
+#include <charconv>
 
 namespace Mcp {
 
@@ -27,33 +32,197 @@ std::unique_ptr<McpServer> McpServer::CreateInstance(const std::string& server_n
 McpServerImpl::McpServerImpl(const std::string& server_name, const std::string& version)
 	: m_server_name(server_name)
 	, m_version(version)
+	, m_tools_list_page_size(0)
 	, m_transport(nullptr)
+	, m_max_requests(0)
+	, m_max_session_requests(0)
 	, m_is_running(false)
+	, m_scheduler(m_executor)
+	, m_tool_thread_count(0)
+	, m_progress_interval(100)
 {
+	auto initialize_result = R"(
+		{
+			"protocolVersion": "2025-06-18",
+			"capabilities": {
+				"logging": {},
+				"tools": {}
+			},
+			"serverInfo": {
+				"name": "",
+				"version": ""
+			}
+		}
+	)"_json;
+
+	initialize_result["serverInfo"]["name"] = m_server_name;
+	initialize_result["serverInfo"]["version"] = m_version;
+	m_initialize_result_str = initialize_result.dump();
+
+	AddMethod("initialize", [this](const McpRequest& request, const nlohmann::json& params) { OnInitialize(request, params); }, MCP_METHOD_LANE_CONTROL);
+	AddMethod("logging/setLevel", [this](const McpRequest& request, const nlohmann::json& params) { OnLoggingSetLevel(request, params); }, MCP_METHOD_LANE_CONTROL);
+	AddMethod("ping", [this](const McpRequest& request, const nlohmann::json& params) { OnPing(request, params); }, MCP_METHOD_LANE_CONTROL);
+	AddMethod("tools/list", [this](const McpRequest& request, const nlohmann::json& params) { OnToolsList(request, params); }, MCP_METHOD_LANE_INLINE);
+	AddRawMethod("tools/call", [this](const McpRequest& request, const std::shared_ptr<const std::string>& buffer, const McpJsonToken& params) { OnToolCall(request, buffer, params); }, MCP_METHOD_LANE_INLINE);
+	AddRawMethod("notifications/cancelled", [this](const McpRequest& request, const std::shared_ptr<const std::string>& buffer, const McpJsonToken& params) { OnCancelled(request, buffer, params); }, MCP_METHOD_LANE_CONTROL);
 }
 
-void McpServerImpl::AddTool(
-	const McpTool& tool,
-	std::function <void(const std::string& session_id, const std::map<std::string, std::string>& args)> callback
-)
+void McpServerImpl::AddTool(const McpTool& tool, McpToolCallback callback)
 {
-	McpToolInfo tool_info;
-	tool_info.name = tool.name;
-	tool_info.description = tool.description;
+	auto tool_info = std::make_shared<McpToolInfo>();
+	tool_info->name = tool.name;
+	tool_info->description = tool.description;
 	for (auto it = tool.input_schema.begin(); it != tool.input_schema.end(); it++)
 	{
-		tool_info.input_schema[it->name] = *it;
+		tool_info->input_schema[it->name] = *it;
 	}
 	for (auto it = tool.output_schema.begin(); it != tool.output_schema.end(); it++)
 	{
-		tool_info.output_schema[it->name] = *it;
+		tool_info->output_schema[it->name] = *it;
 	}
-	tool_info.callback = callback;
+	tool_info->input_validator = McpInputValidator(tool.input_schema);
+	tool_info->callback = callback;
+	tool_info->timeout = tool.timeout;
+	tool_info->idempotent = tool.idempotent;
+	tool_info->cache_ttl = tool.cache_ttl;
+	if (tool.cache_ttl.count() > 0 && !tool.idempotent)
+	{
+		MCP_LOG_WARNING("tool %s has a cache_ttl but is not idempotent, its results are not cached", tool.name.c_str());
+	}
+	tool_info->record_str = CreateToolRecord(*tool_info);
+
+	std::lock_guard<std::mutex> lock(m_tools_mutex);
+
 	m_tools[tool.name] = tool_info;
+	m_tools_list_str.clear();
+}
+
+void McpServerImpl::SetToolsListPageSize(size_t page_size)
+{
+	std::lock_guard<std::mutex> lock(m_tools_mutex);
+
+	m_tools_list_page_size = page_size;
+}
+
+void McpServerImpl::RegisterMethod(const std::string& method, McpMethodCallback callback)
+{
+	AddMethod(method, callback, MCP_METHOD_LANE_EXECUTOR);
+}
+
+void McpServerImpl::AddMethod(const std::string& method, McpMethodCallback callback, McpMethodLane lane)
+{
+	McpMethodInfo method_info;
+	method_info.callback = callback;
+	method_info.lane = lane;
+	m_methods[method] = method_info;
+}
+
+void McpServerImpl::AddRawMethod(const std::string& method, McpRawMethodCallback raw_callback, McpMethodLane lane)
+{
+	McpMethodInfo method_info;
+	method_info.raw_callback = raw_callback;
+	method_info.lane = lane;
+	m_methods[method] = method_info;
+}
+
+bool McpServerImpl::IsControl(std::string_view method)
+{
+	auto it = m_methods.find(method);
+
+	return it != m_methods.end() && it->second.lane == MCP_METHOD_LANE_CONTROL;
+}
+
+void McpServerImpl::SetRequestLimits(size_t max_requests, size_t max_session_requests)
+{
+	std::lock_guard<std::mutex> lock(m_request_mutex);
+
+	m_max_requests = max_requests;
+	m_max_session_requests = max_session_requests;
+}
+
+void McpServerImpl::SetToolThreadCount(size_t thread_count)
+{
+	m_tool_thread_count = thread_count;
+}
+
+McpExecutorStats McpServerImpl::GetExecutorStats()
+{
+	McpExecutorStats stats;
+	stats.thread_count = m_executor.GetThreadCount();
+	stats.queue_depth = m_executor.GetQueueDepth() + m_scheduler.GetQueueDepth();
+	stats.busy_threads = m_executor.GetBusyThreadCount();
+
+	return stats;
+}
+
+void McpServerImpl::SetSessionWeightCallback(McpSessionWeightCallback callback)
+{
+	m_scheduler.SetWeightCallback(callback);
+}
+
+void McpServerImpl::SetCacheMemoryLimit(size_t memory_limit)
+{
+	m_result_cache.SetMemoryLimit(memory_limit);
+}
+
+McpCacheStats McpServerImpl::GetCacheStats()
+{
+	McpCacheStats stats;
+	stats.hits = m_result_cache.GetHitCount();
+	stats.misses = m_result_cache.GetMissCount();
+	stats.entries = m_result_cache.GetEntryCount();
+	stats.memory_usage = m_result_cache.GetMemoryUsage();
+
+	return stats;
+}
+
+void McpServerImpl::AddAsyncTool(const McpTool& tool, McpAsyncToolCallback callback)
+{
+	// A coroutine lambda refers to its captures through the closure object,
+	// so the callback must stay alive until every call has completed.
+	auto shared_callback = std::make_shared<McpAsyncToolCallback>(callback);
+
+	AddTool(tool, [this, shared_callback](const McpRequest& request, const McpArguments& args)
+	{
+		McpTask task = (*shared_callback)(request, args);
+		task.Start(
+			[this, session_id = request.session_id](std::function<void()> resume, std::chrono::milliseconds delay)
+			{
+				// Each resume takes its turn like a new call, so awaiting does not let a
+				// session skip ahead of the others.
+				if (delay.count() <= 0)
+				{
+					m_scheduler.Post(session_id, std::move(resume));
+					return;
+				}
+
+				m_executor.RunAfter(delay, [this, session_id, resume]
+				{
+					m_scheduler.Post(session_id, resume);
+				});
+			},
+			[this, request, shared_callback](std::vector<McpContent> contents)
+			{
+				SendToolResponse(request, contents);
+			},
+			[this, request, shared_callback](std::exception_ptr /* error */)
+			{
+				SendError(request, -32603, "Internal error");
+			}
+		);
+	});
 }
 
 bool McpServerImpl::Run(std::unique_ptr<McpServerTransport> transport)
 {
+	size_t thread_count = m_tool_thread_count;
+	if (thread_count == 0)
+	{
+		thread_count = std::thread::hardware_concurrency();
+	}
+	m_executor.Start(thread_count);
+	m_scheduler.SetSlotCount(thread_count);
+
 	m_transport = std::move(transport);
 	m_transport->Open(this);
 
@@ -68,6 +237,8 @@ bool McpServerImpl::Run(std::unique_ptr<McpServerTransport> transport)
 				break;
 			}
 		}
+
+		m_is_running = false;
 	});
 
 	return true;
@@ -84,8 +255,15 @@ void McpServerImpl::Stop()
 	m_worker->join();
 	m_worker.reset();
 
+	// Every event loop must be done posting work before the executor goes away, and
+	// the executor done sending responses before the transport does.
+	m_transport->Stop();
+	m_executor.Stop();
+
 	m_transport->Close();
 	m_transport.reset();
+
+	McpLogger::Flush();
 }
 
 bool McpServerImpl::IsRunning()
@@ -95,431 +273,1423 @@ bool McpServerImpl::IsRunning()
 
 void McpServerImpl::OnClose(const std::string& session_id)
 {
-	m_request_id.erase(session_id);
-}
-
-bool McpServerImpl::OnRecv(const std::string& session_id, const std::string& request_str)
-{
-	try
+	std::vector<McpCancellationToken> cancellations;
+	std::vector<std::string> cache_keys;
 	{
-		auto request = nlohmann::json::parse(request_str);
+		std::lock_guard<std::mutex> lock(m_request_mutex);
 
-		if (request.contains("method"))
+		auto it = m_requests.lower_bound(McpRequestKey(session_id, ""));
+		while (it != m_requests.end() && it->first.first == session_id)
 		{
-			std::string method = request.at("method");
-			if (method == "notifications/initialized" ||
-				method == "notifications/cancelled")
-			{
-				return false;
-			}
-
-			if (request.contains("id"))
-			{
-				m_request_id[session_id] = request.at("id").get<int>();
-
-				if (method == "initialize")
-				{
-					OnInitialize(session_id, request);
-				}
-				else if (method == "logging/setLevel")
-				{
-					OnLoggingSetLevel(session_id, request);
-				}
-				else if (method == "ping")
-				{
-					OnPing(session_id, request);
-				}
-				else if (method == "tools/list")
-				{
-					OnToolsList(session_id, request);
-				}
-				else if (method == "tools/call")
-				{
-					OnToolCall(session_id, request);
-				}
-				else
-				{
-					SendError(session_id, -32601, "Method not found");
-				}
-			}
-			else
+			cancellations.emplace_back(it->second.request.cancellation);
+			if (!it->second.cache_key.empty())
 			{
-				SendError(session_id, -32600, "Invalid request");
+				cache_keys.emplace_back(it->second.cache_key);
 			}
-		}
-		else
-		{
-			SendError(session_id, -32600, "Invalid request");
+			it = EraseRequest(it);
 		}
 	}
-	catch (const nlohmann::json::parse_error& e)
+
+	for (auto it = cancellations.begin(); it != cancellations.end(); it++)
+	{
+		it->Cancel();
+	}
+	for (auto it = cache_keys.begin(); it != cache_keys.end(); it++)
 	{
-		SendError(session_id, -32700, "Parse error");
+		AbandonFlight(*it);
 	}
 
-	return true;
-}
+	{
+		std::lock_guard<std::mutex> lock(m_progress_mutex);
 
-void McpServerImpl::OnInitialize(const std::string& session_id, const nlohmann::json& request)
-{
-	auto response = R"(
+		auto it = m_progress.lower_bound(McpRequestKey(session_id, ""));
+		while (it != m_progress.end() && it->first.first == session_id)
 		{
-			"jsonrpc": "2.0",
-			"id": 0,
-			"result": {
-				"protocolVersion": "2025-06-18",
-				"capabilities": {
-					"logging": {},
-					"tools": {}
-				},
-				"serverInfo": {
-					"name": "",
-					"version": ""
-				}
-			}
+			it = m_progress.erase(it);
 		}
-	)"_json;
+	}
 
-	response["id"] = request.at("id").get<int>();
-	response["result"]["serverInfo"]["name"] = m_server_name;
-	response["result"]["serverInfo"]["version"] = m_version;
+	{
+		std::lock_guard<std::mutex> lock(m_log_level_mutex);
+
+		m_session_log_levels.erase(session_id);
+	}
 
-	SendResponse(session_id, response);
+	if (!cancellations.empty())
+	{
+		MCP_LOG_INFO("session %s closed with %zu requests in flight", session_id.c_str(), cancellations.size());
+	}
 }
 
-void McpServerImpl::OnLoggingSetLevel(const std::string& session_id, const nlohmann::json& request)
+bool McpServerImpl::OnRecv(const std::string& session_id, unsigned long long stream_id, std::string request_str)
 {
-	auto response = R"(
-		{
-			"jsonrpc": "2.0",
-			"id": 0,
-			"result": {}
-		}
-	)"_json;
+	McpRequest request;
+	request.session_id = session_id;
+	request.stream_id = stream_id;
+
+	// Parsing only validates and locates values; batch elements and tool arguments
+	// keep referring to this buffer.
+	auto buffer = std::make_shared<const std::string>(std::move(request_str));
+
+	McpJsonToken request_token;
+	if (!McpJsonReader::Parse(*buffer, request_token))
+	{
+		MCP_LOG_DEBUG("session %s sent malformed JSON (%zu bytes)", session_id.c_str(), buffer->size());
+		SendError(request, -32700, "Parse error");
+		return true;
+	}
 
-	response["id"] = request.at("id").get<int>();
+	if (request_token.type == MCP_JSON_TYPE_ARRAY)
+	{
+		return ProcBatch(request, buffer, request_token);
+	}
 
-	SendResponse(session_id, response);
+	return ProcRequest(request, buffer, request_token);
 }
 
-void McpServerImpl::OnPing(const std::string& session_id, const nlohmann::json& request)
+bool McpServerImpl::CanAccept(const std::string& session_id, const std::string& method)
 {
-	auto response = R"(
-		{
-			"jsonrpc": "2.0",
-			"id": null,
-			"result": {}
-		}
-	)"_json;
+	if (IsControl(method))
+	{
+		return true;
+	}
 
-	response["id"] = request.at("id").get<int>();
+	std::lock_guard<std::mutex> lock(m_request_mutex);
 
-	SendResponse(session_id, response);
+	return !IsOverloaded(session_id);
 }
 
-void McpServerImpl::OnToolsList(const std::string& session_id, const nlohmann::json& request)
+bool McpServerImpl::ProcRequest(McpRequest& request, const std::shared_ptr<const std::string>& buffer, const McpJsonToken& request_token)
 {
-	auto response = R"(
+	McpJsonToken id_token{};
+	McpJsonToken method_token{};
+	McpJsonToken params_token{};
+	bool is_valid_version = true;
+
+	McpJsonReader::ForEachMember(request_token, [&](const McpJsonToken& key, const McpJsonToken& value)
+	{
+		std::string_view name = McpJsonReader::GetStringContent(key);
+		if (name == "jsonrpc")
 		{
-			"jsonrpc": "2.0",
-			"id": 0,
-			"result": {
-				"tools": []
-			}
+			is_valid_version = McpJsonReader::Equals(value, "2.0");
 		}
-	)"_json;
+		else if (name == "id")
+		{
+			id_token = value;
+		}
+		else if (name == "method")
+		{
+			method_token = value;
+		}
+		else if (name == "params")
+		{
+			params_token = value;
+		}
+		return true;
+	});
 
-	response["id"] = request.at("id").get<int>();
+	if (!is_valid_version || method_token.type != MCP_JSON_TYPE_STRING)
+	{
+		SendError(request, -32600, "Invalid request");
+		return true;
+	}
 
-	for (auto it = m_tools.begin(); it != m_tools.end(); it++)
+	std::string_view method = McpJsonReader::GetStringContent(method_token);
+	std::string unescaped_method;
+	if (McpJsonReader::HasEscape(method_token))
 	{
-		McpToolInfo& tool_info = it->second;
+		McpJsonReader::AppendUnescaped(unescaped_method, method_token);
+		method = unescaped_method;
+	}
+	auto it = m_methods.find(method);
 
-		auto tool_record = R"(
+	try
+	{
+		// A notification is never answered, so an id sent along with one is ignored
+		// instead of registering a request that would never finish.
+		bool is_notification = IsNotification(method);
+		if (id_token.type == MCP_JSON_TYPE_INVALID || is_notification)
+		{
+			if (!is_notification)
 			{
-				"name": "",
-				"description": "",
-				"inputSchema": {
-					"type": "object",
-					"properties" : {},
-					"required": []
-				}
+				SendError(request, -32600, "Invalid request");
+				return true;
 			}
-		)"_json;
-
-		tool_record["name"] = tool_info.name;
-		tool_record["description"] = tool_info.description;
 
-		if (tool_info.input_schema.size() > 0)
-		{
-			for (auto it = tool_info.input_schema.begin(); it != tool_info.input_schema.end(); it++)
+			if (it != m_methods.end())
 			{
-				auto property_record = R"(
-					{ 
-						"type": "",
-						"description": ""
-					}
-				)"_json;
-
-				const auto& prop = it->second;
-				property_record["type"] = McpPropertyTypeToString(prop.type);
-				property_record["description"] = prop.description;
-				tool_record["inputSchema"]["properties"][prop.name] = property_record;
-
-				if (prop.required)
-				{
-					tool_record["inputSchema"]["required"].emplace_back(prop.name);
-				}
+				DispatchMethod(it->second, request, buffer, params_token);
 			}
+			return false;
 		}
 
-		if (tool_info.output_schema.size() > 0)
+		if (id_token.type != MCP_JSON_TYPE_STRING && id_token.type != MCP_JSON_TYPE_NUMBER && id_token.type != MCP_JSON_TYPE_NULL)
 		{
-			auto output_schema = R"(
-				{ 
-					"type": "object",
-					"properties": {
-						"content": {
-							"type": "array",
-							"items": {
-								"type": "object",
-								"properties": {
-								},
-								"required": []
-							}
-						}
-					},
-					"required": [ "content" ]
-				}
-			)"_json;
-
-			for (auto it = tool_info.output_schema.begin(); it != tool_info.output_schema.end(); it++)
-			{
-				auto property_record = R"(
-					{ 
-						"type": "",
-						"description": ""
-					}
-				)"_json;
-
-				const auto& prop = it->second;
-				property_record["type"] = McpPropertyTypeToString(prop.type);
-				property_record["description"] = prop.description;
-				output_schema["properties"]["content"]["items"]["properties"][prop.name] = property_record;
+			SendError(request, -32600, "Invalid request");
+			return true;
+		}
 
-				if (prop.required)
-				{
-					output_schema["properties"]["content"]["items"]["required"].emplace_back(prop.name);
-				}
-			}
+		request.id = std::string(id_token.raw);
+		request.cancellation = McpCancellationToken::Create();
+		McpBeginResult begin_result = BeginRequest(request, it != m_methods.end() && it->second.lane == MCP_METHOD_LANE_CONTROL);
+		if (begin_result == MCP_BEGIN_OVERLOADED)
+		{
+			MCP_LOG_WARNING("session %s overloaded, rejecting %.*s", request.session_id.c_str(), (int)method.size(), method.data());
+			DeliverError(request, -32000, "Server overloaded");
+			return true;
+		}
+		if (begin_result == MCP_BEGIN_DUPLICATE)
+		{
+			request.id = "";
+			SendError(request, -32600, "Invalid request");
+			return true;
+		}
 
-			tool_record["outputSchema"] = output_schema;
+		if (it == m_methods.end())
+		{
+			MCP_LOG_DEBUG("session %s called unknown method %.*s", request.session_id.c_str(), (int)method.size(), method.data());
+			SendError(request, -32601, "Method not found");
+			return true;
 		}
 
-		response["result"]["tools"].emplace_back(tool_record);
+		DispatchMethod(it->second, request, buffer, params_token);
+	}
+	catch (const nlohmann::json::exception& e)
+	{
+		SendError(request, -32600, "Invalid request");
 	}
 
-	SendResponse(session_id, response);
+	return true;
 }
 
-void McpServerImpl::OnToolCall(const std::string& session_id, const nlohmann::json& request)
+bool McpServerImpl::ProcBatch(McpRequest& request, const std::shared_ptr<const std::string>& buffer, const McpJsonToken& batch_token)
 {
-	std::string name = request["params"]["name"];
+	// Every element except a notification produces exactly one response,
+	// so the number of responses to collect is known before dispatching.
+	auto batch = std::make_shared<McpBatch>();
+	batch->pending = 0;
+	size_t element_count = 0;
+	McpJsonReader::ForEachElement(batch_token, [&](const McpJsonToken& element)
+	{
+		element_count++;
+		if (!IsNotification(GetMethod(element)))
+		{
+			batch->pending++;
+		}
+		return true;
+	});
 
-	auto it = m_tools.find(name);
-	if (it == m_tools.end())
+	if (element_count == 0)
 	{
-		SendError(session_id, -32602, "Unknown tool: invalid_tool_name");
-		return;
+		SendError(request, -32600, "Invalid request");
+		return true;
 	}
 
-	auto raequestArguments = request["params"]["arguments"];
+	if (batch->pending == 0)
+	{
+		McpJsonReader::ForEachElement(batch_token, [&](const McpJsonToken& element)
+		{
+			McpRequest element_request = request;
+			ProcRequest(element_request, buffer, element);
+			return true;
+		});
+		return false;
+	}
 
-	std::map<std::string, std::string> arguments;
+	batch->responses.reserve(batch->pending);
+	request.batch = batch;
 
-	McpToolInfo& tool_info = it->second;
-	for (auto it2 = tool_info.input_schema.begin(); it2 != tool_info.input_schema.end(); it2++)
+	McpJsonReader::ForEachElement(batch_token, [&](const McpJsonToken& element)
 	{
-		const auto& prop = it2->second;
+		McpRequest element_request = request;
 
-		if (raequestArguments.contains(prop.name))
+		// Control messages are answered right away instead of queueing behind tool work.
+		if (IsControl(GetMethod(element)))
 		{
-			arguments[prop.name] = raequestArguments.at(prop.name);
+			ProcRequest(element_request, buffer, element);
+			return true;
 		}
-		else
+
+		m_scheduler.Post(request.session_id, [this, element_request, buffer, element]() mutable
 		{
-			arguments[prop.name] = "";
-		}
+			ProcRequest(element_request, buffer, element);
+		});
+		return true;
+	});
+
+	return true;
+}
+
+// Unescaped the same way as in ProcRequest, so both classify an element alike.
+std::string McpServerImpl::GetMethod(const McpJsonToken& request_token)
+{
+	std::string method;
 
-		if (prop.required && arguments[prop.name].empty())
+	McpJsonReader::ForEachMember(request_token, [&](const McpJsonToken& key, const McpJsonToken& value)
+	{
+		if (McpJsonReader::GetStringContent(key) == "method" && value.type == MCP_JSON_TYPE_STRING)
 		{
-			SendError(session_id, -32602, "Unknown tool: missing_required_params");
-			return;
+			method.clear();
+			McpJsonReader::AppendUnescaped(method, value);
 		}
-	}
+		return true;
+	});
 
-	tool_info.callback(session_id, arguments);
+	return method;
 }
 
-void McpServerImpl::SendResponse(const std::string& session_id, const nlohmann::json& response)
+bool McpServerImpl::IsNotification(std::string_view method)
 {
-	m_transport->SendResponse(session_id, response.dump());
-
-	m_request_id.erase(session_id);
+	return method.compare(0, 14, "notifications/") == 0;
 }
 
-void McpServerImpl::SendError(const std::string& session_id, int code, const std::string& message)
+// An empty |response_str| releases the stream slot of a cancelled request without answering it.
+void McpServerImpl::DeliverResponse(const McpRequest& request, const std::string& response_str)
 {
-	auto response = R"(
+	if (!request.batch)
+	{
+		if (response_str.empty())
 		{
-			"jsonrpc": "2.0",
-			"id": null,
-			"error": {
-				"code": -32600,
-				"message": "Invalid request"
-			}
+			m_transport->CancelResponse(request.session_id, request.stream_id);
+			return;
 		}
-	)"_json;
 
-	auto it = m_request_id.find(session_id);
-	if (it != m_request_id.end())
-	{
-		response["id"] = it->second;
+		m_transport->SendResponse(request.session_id, request.stream_id, response_str);
+		return;
 	}
 
-	response["error"]["code"] = code;
-	response["error"]["message"] = message;
-
-	m_transport->SendResponse(session_id, response.dump());
+	std::string batch_str;
+	{
+		std::lock_guard<std::mutex> lock(request.batch->mutex);
 
-	m_request_id.erase(session_id);
-}
+		if (!response_str.empty())
+		{
+			request.batch->responses.emplace_back(response_str);
+		}
+		if (--request.batch->pending > 0)
+		{
+			return;
+		}
 
-void McpServerImpl::SendToolNotification(const std::string& session_id, const std::string& method, const nlohmann::json& params)
-{
-	auto notification = R"(
+		if (request.batch->responses.empty())
 		{
-			"jsonrpc": "2.0",
-			"method": "",
-			"params": {}
+			m_transport->CancelResponse(request.session_id, request.stream_id);
+			return;
 		}
-	)"_json;
 
-	notification["method"] = "notifications/" + method;
-	notification["params"] = params;
+		batch_str = "[";
+		for (size_t i = 0; i < request.batch->responses.size(); i++)
+		{
+			if (i > 0)
+			{
+				batch_str += ",";
+			}
+			batch_str += request.batch->responses[i];
+		}
+		batch_str += "]";
+	}
 
-	m_transport->SendResponse(session_id, notification.dump(), false);
+	m_transport->SendResponse(request.session_id, request.stream_id, batch_str);
 }
 
-void McpServerImpl::SendToolResponse(const std::string& session_id, const std::string& method, std::vector<McpContent> contents)
+void McpServerImpl::DispatchMethod(const McpMethodInfo& method_info, const McpRequest& request, const std::shared_ptr<const std::string>& buffer, const McpJsonToken& params_token)
 {
-	auto it2 = m_tools.find(method);
-	if (it2 == m_tools.end())
+	if (method_info.raw_callback)
 	{
+		method_info.raw_callback(request, buffer, params_token);
 		return;
 	}
-	McpToolInfo& tool_info = it2->second;
 
-	auto response = R"(
-		{
-			"jsonrpc": "2.0",
-			"id": null,
-			"result": {
-				"content": []
-			}
-		}
-	)"_json;
+	nlohmann::json params = nlohmann::json::object();
+	if (params_token.type != MCP_JSON_TYPE_INVALID)
+	{
+		params = nlohmann::json::parse(params_token.raw.begin(), params_token.raw.end());
+	}
 
-	auto it = m_request_id.find(session_id);
-	if (it == m_request_id.end())
+	if (method_info.lane != MCP_METHOD_LANE_EXECUTOR)
 	{
+		method_info.callback(request, params);
 		return;
 	}
 
-	response["id"] = it->second;
-
-	if (tool_info.output_schema.size() == 0)
+	McpMethodCallback callback = method_info.callback;
+	m_scheduler.Post(request.session_id, [this, callback, request, params]
 	{
-		for (auto it = contents.begin(); it != contents.end(); it++)
+		if (request.cancellation.IsCancelled())
 		{
-			auto content = R"(
-				{
-					"type": "text",
-					"text": ""
-				}
-			)"_json;
-
-			if (it->properties.size() > 0)
-			{
-				content["text"] = it->properties[0].value;
-			}
-
-			response["result"]["content"].emplace_back(content);
+			return;
 		}
-	}
-	else
-	{
-		auto structured_content = R"(
-			{
-				"content": []
-			}
-		)"_json;
 
-		for (auto it = contents.begin(); it != contents.end(); it++)
+		try
 		{
-			McpContent& content = *it;
-
-			std::string content_json = "{\"type\": \"text\",\"text\": \"{";
-			std::string structured_content_json = "{";
+			callback(request, params);
+		}
+		catch (const std::exception& e)
+		{
+			MCP_LOG_ERROR("method handler failed: %s", e.what());
+			SendError(request, -32603, "Internal error");
+		}
+	});
+}
 
-			for (size_t j = 0; j < content.properties.size(); j++)
-			{
-				if (j > 0)
-				{
-					content_json += ",";
-					structured_content_json += ",";
-				}
-				content_json += "\\\"" + content.properties[j].name + "\\\": " + GetPropertyValue(tool_info.output_schema, content.properties[j], true);
-				structured_content_json += "\"" + content.properties[j].name + "\": " + GetPropertyValue(tool_info.output_schema, content.properties[j], false);
-			}
+McpServerImpl::McpBeginResult McpServerImpl::BeginRequest(const McpRequest& request, bool is_control)
+{
+	std::lock_guard<std::mutex> lock(m_request_mutex);
 
-			content_json += "}\"}";
-			response["result"]["content"].emplace_back(nlohmann::json::parse(content_json));
+	if (!is_control && IsOverloaded(request.session_id))
+	{
+		return MCP_BEGIN_OVERLOADED;
+	}
 
-			structured_content_json += "}";
-			structured_content["content"].emplace_back(nlohmann::json::parse(structured_content_json));
-		}
+	McpRequestInfo request_info;
+	request_info.request = request;
 
-		response["result"]["structuredContent"] = structured_content;
+	if (!m_requests.emplace(McpRequestKey(request.session_id, request.id), request_info).second)
+	{
+		return MCP_BEGIN_DUPLICATE;
 	}
+	m_session_request_counts[request.session_id]++;
 
-	m_transport->SendResponse(session_id, response.dump(), true);
+	return MCP_BEGIN_OK;
+}
+
+// Must be called with m_request_mutex held.
+std::map<McpServerImpl::McpRequestKey, McpServerImpl::McpRequestInfo>::iterator McpServerImpl::EraseRequest(std::map<McpRequestKey, McpRequestInfo>::iterator it)
+{
+	auto it2 = m_session_request_counts.find(it->first.first);
+	if (it2 != m_session_request_counts.end() && --it2->second == 0)
+	{
+		m_session_request_counts.erase(it2);
+	}
+
+	// A finished request must not keep its timeout, and with it a copy of the request, queued.
+	if (it->second.timeout_timer != 0)
+	{
+		m_executor.CancelTimer(it->second.timeout_timer);
+	}
+
+	return m_requests.erase(it);
+}
+
+// Must be called with m_request_mutex held.
+bool McpServerImpl::IsOverloaded(const std::string& session_id)
+{
+	if (m_max_requests > 0 && m_requests.size() >= m_max_requests)
+	{
+		return true;
+	}
+
+	if (m_max_session_requests > 0 && !session_id.empty())
+	{
+		auto it = m_session_request_counts.find(session_id);
+		if (it != m_session_request_counts.end() && it->second >= m_max_session_requests)
+		{
+			return true;
+		}
+	}
+
+	return false;
+}
+
+bool McpServerImpl::FinishRequest(const McpRequest& request, McpRequestInfo* request_info)
+{
+	McpRequestInfo finished_info;
+	{
+		std::lock_guard<std::mutex> lock(m_request_mutex);
+
+		auto it = m_requests.find(McpRequestKey(request.session_id, request.id));
+		if (it == m_requests.end())
+		{
+			return false;
+		}
+
+		finished_info = it->second;
+		EraseRequest(it);
+	}
+
+	EndProgress(finished_info.request);
+
+	if (request_info != nullptr)
+	{
+		*request_info = std::move(finished_info);
+	}
+
+	return true;
+}
+
+void McpServerImpl::CancelRequest(const McpRequestKey& request_key)
+{
+	McpRequestInfo request_info;
+	{
+		std::lock_guard<std::mutex> lock(m_request_mutex);
+
+		auto it = m_requests.find(request_key);
+		if (it == m_requests.end())
+		{
+			return;
+		}
+
+		request_info = it->second;
+		EraseRequest(it);
+	}
+
+	EndProgress(request_info.request);
+
+	// The entry is gone, so the response the tool eventually sends is dropped.
+	request_info.request.cancellation.Cancel();
+	DeliverResponse(request_info.request, "");
+
+	if (!request_info.cache_key.empty())
+	{
+		AbandonFlight(request_info.cache_key);
+	}
+}
+
+void McpServerImpl::ExpireRequest(const McpRequest& request)
+{
+	std::string cache_key;
+	{
+		std::lock_guard<std::mutex> lock(m_request_mutex);
+
+		// The id may already belong to a newer request, which has its own token.
+		auto it = m_requests.find(McpRequestKey(request.session_id, request.id));
+		if (it == m_requests.end() || it->second.request.cancellation != request.cancellation)
+		{
+			return;
+		}
+
+		cache_key = it->second.cache_key;
+		EraseRequest(it);
+	}
+
+	EndProgress(request);
+
+	MCP_LOG_WARNING("request %s of session %s timed out", request.id.c_str(), request.session_id.c_str());
+	request.cancellation.Cancel();
+	DeliverError(request, -32001, "Request timed out");
+
+	if (!cache_key.empty())
+	{
+		AbandonFlight(cache_key);
+	}
+}
+
+void McpServerImpl::OnInitialize(const McpRequest& request, const nlohmann::json& /* params */)
+{
+	SendRawResponse(request, m_initialize_result_str);
+}
+
+void McpServerImpl::OnLoggingSetLevel(const McpRequest& request, const nlohmann::json& params)
+{
+	McpLogLevel level = MCP_LOG_LEVEL_UNKNOWN;
+	auto it = params.find("level");
+	if (it != params.end() && it->is_string())
+	{
+		level = StringToMcpLogLevel(it->get_ref<const std::string&>());
+	}
+
+	if (level == MCP_LOG_LEVEL_UNKNOWN)
+	{
+		SendError(request, -32602, "Invalid params");
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(m_log_level_mutex);
+
+		m_session_log_levels[request.session_id] = level;
+	}
+
+	SendRawResponse(request, "{}");
+}
+
+void McpServerImpl::OnPing(const McpRequest& request, const nlohmann::json& /* params */)
+{
+	SendRawResponse(request, "{}");
+}
+
+std::string McpServerImpl::CreateToolRecord(const McpToolInfo& tool_info)
+{
+	auto tool_record = R"(
+		{
+			"name": "",
+			"description": "",
+			"inputSchema": {
+				"type": "object",
+				"properties" : {},
+				"required": []
+			}
+		}
+	)"_json;
+
+	tool_record["name"] = tool_info.name;
+	tool_record["description"] = tool_info.description;
+
+	if (tool_info.input_schema.size() > 0)
+	{
+		for (auto it = tool_info.input_schema.begin(); it != tool_info.input_schema.end(); it++)
+		{
+			auto property_record = R"(
+				{ 
+					"type": "",
+					"description": ""
+				}
+			)"_json;
+
+			const auto& prop = it->second;
+			property_record["type"] = McpPropertyTypeToString(prop.type);
+			property_record["description"] = prop.description;
+			for (auto it2 = prop.enum_values.begin(); it2 != prop.enum_values.end(); it2++)
+			{
+				if ((prop.type == MCP_PROPERTY_TYPE_NUMBER || prop.type == MCP_PROPERTY_TYPE_INTEGER) && McpJsonReader::IsNumber(*it2))
+				{
+					property_record["enum"].emplace_back(nlohmann::json::parse(*it2));
+				}
+				else
+				{
+					property_record["enum"].emplace_back(*it2);
+				}
+			}
+			if (prop.minimum)
+			{
+				property_record["minimum"] = *prop.minimum;
+			}
+			if (prop.maximum)
+			{
+				property_record["maximum"] = *prop.maximum;
+			}
+			tool_record["inputSchema"]["properties"][prop.name] = property_record;
+
+			if (prop.required)
+			{
+				tool_record["inputSchema"]["required"].emplace_back(prop.name);
+			}
+		}
+	}
+
+	if (tool_info.output_schema.size() > 0)
+	{
+		auto output_schema = R"(
+			{ 
+				"type": "object",
+				"properties": {
+					"content": {
+						"type": "array",
+						"items": {
+							"type": "object",
+							"properties": {
+							},
+							"required": []
+						}
+					}
+				},
+				"required": [ "content" ]
+			}
+		)"_json;
+
+		for (auto it = tool_info.output_schema.begin(); it != tool_info.output_schema.end(); it++)
+		{
+			auto property_record = R"(
+				{ 
+					"type": "",
+					"description": ""
+				}
+			)"_json;
+
+			const auto& prop = it->second;
+			property_record["type"] = McpPropertyTypeToString(prop.type);
+			property_record["description"] = prop.description;
+			output_schema["properties"]["content"]["items"]["properties"][prop.name] = property_record;
+
+			if (prop.required)
+			{
+				output_schema["properties"]["content"]["items"]["required"].emplace_back(prop.name);
+			}
+		}
+
+		tool_record["outputSchema"] = output_schema;
+	}
 
-	m_request_id.erase(session_id);
+	return tool_record.dump();
 }
 
-std::string McpServerImpl::GetPropertyValue(const std::map<std::string, McpProperty>& output_schema, McpPropertyValue value, bool escape)
+void McpServerImpl::OnToolsList(const McpRequest& request, const nlohmann::json& params)
 {
-	auto it = output_schema.find(value.name);
-	if (it == output_schema.end())
+	std::string cursor;
+	auto cursor_value = params.find("cursor");
+	if (cursor_value != params.end())
+	{
+		if (!cursor_value->is_string())
+		{
+			SendError(request, -32602, "Invalid params");
+			return;
+		}
+		cursor = cursor_value->get<std::string>();
+	}
+
+	bool is_valid_cursor = true;
+	std::string result_str;
+	{
+		std::lock_guard<std::mutex> lock(m_tools_mutex);
+
+		// A cursor names the first tool of its page, so one naming no tool was not issued here.
+		if (cursor_value != params.end() && (m_tools_list_page_size == 0 || m_tools.find(cursor) == m_tools.end()))
+		{
+			is_valid_cursor = false;
+		}
+		else if (m_tools_list_page_size == 0 || (cursor.empty() && m_tools.size() <= m_tools_list_page_size))
+		{
+			if (m_tools_list_str.empty())
+			{
+				m_tools_list_str = "{\"tools\":[";
+				for (auto it = m_tools.begin(); it != m_tools.end(); it++)
+				{
+					if (it != m_tools.begin())
+					{
+						m_tools_list_str += ",";
+					}
+					m_tools_list_str += it->second->record_str;
+				}
+				m_tools_list_str += "]}";
+			}
+			result_str = m_tools_list_str;
+		}
+		else
+		{
+			// Tools added since the cursor was issued do not make it stale.
+			auto it = m_tools.lower_bound(cursor);
+
+			result_str = "{\"tools\":[";
+			for (size_t i = 0; i < m_tools_list_page_size && it != m_tools.end(); i++, it++)
+			{
+				if (i > 0)
+				{
+					result_str += ",";
+				}
+				result_str += it->second->record_str;
+			}
+			result_str += "]";
+
+			if (it != m_tools.end())
+			{
+				result_str += ",\"nextCursor\":";
+				result_str += nlohmann::json(it->first).dump();
+			}
+			result_str += "}";
+		}
+	}
+
+	if (!is_valid_cursor)
+	{
+		SendError(request, -32602, "Invalid params");
+		return;
+	}
+
+	SendRawResponse(request, result_str);
+}
+
+void McpServerImpl::OnToolCall(const McpRequest& request, const std::shared_ptr<const std::string>& buffer, const McpJsonToken& params)
+{
+	McpJsonToken name_token{};
+	McpJsonToken arguments_token{};
+	McpJsonToken meta_token{};
+
+	McpJsonReader::ForEachMember(params, [&](const McpJsonToken& key, const McpJsonToken& value)
+	{
+		std::string_view name = McpJsonReader::GetStringContent(key);
+		if (name == "name")
+		{
+			name_token = value;
+		}
+		else if (name == "arguments")
+		{
+			arguments_token = value;
+		}
+		else if (name == "_meta")
+		{
+			meta_token = value;
+		}
+		return true;
+	});
+
+	std::string_view name = McpJsonReader::GetStringContent(name_token);
+	std::string unescaped_name;
+	if (McpJsonReader::HasEscape(name_token))
+	{
+		McpJsonReader::AppendUnescaped(unescaped_name, name_token);
+		name = unescaped_name;
+	}
+
+	std::shared_ptr<McpToolInfo> tool_info_ptr;
+	{
+		std::lock_guard<std::mutex> lock(m_tools_mutex);
+
+		auto it = m_tools.find(name);
+		if (it != m_tools.end())
+		{
+			tool_info_ptr = it->second;
+		}
+	}
+	if (!tool_info_ptr)
 	{
-		return "";
+		SendError(request, -32602, "Unknown tool: invalid_tool_name");
+		return;
 	}
 
-	switch (it->second.type) {
+	McpArguments arguments;
+	std::string argument_name;
+	switch (tool_info_ptr->input_validator.Validate(buffer, arguments_token, arguments, argument_name)) {
+	case MCP_VALIDATION_OK:
+		break;
+	case MCP_VALIDATION_MISSING:
+		SendError(request, -32602, "Unknown tool: missing_required_params");
+		return;
+	case MCP_VALIDATION_WRONG_TYPE:
+		SendError(request, -32602, "Invalid params: wrong type for " + argument_name);
+		return;
+	case MCP_VALIDATION_OUT_OF_RANGE:
+		SendError(request, -32602, "Invalid params: " + argument_name + " is out of range");
+		return;
+	case MCP_VALIDATION_NOT_IN_ENUM:
+		SendError(request, -32602, "Invalid params: " + argument_name + " is not an allowed value");
+		return;
+	}
+
+	std::string cache_key;
+	if (tool_info_ptr->idempotent)
+	{
+		cache_key = CreateCacheKey(*tool_info_ptr, arguments);
+
+		if (tool_info_ptr->cache_ttl.count() > 0)
+		{
+			auto result = m_result_cache.Get(cache_key);
+			if (result)
+			{
+				SendRawResponse(request, *result);
+				return;
+			}
+		}
+	}
+
+	McpRequest tool_request = request;
+
+	// The earlier of the tool's own limit and the client's deadline wins.
+	std::chrono::milliseconds timeout = tool_info_ptr->timeout;
+	std::chrono::milliseconds client_timeout;
+	ReadMeta(meta_token, client_timeout, tool_request.progress_token);
+	if (client_timeout.count() > 0 && (timeout.count() <= 0 || client_timeout < timeout))
+	{
+		timeout = client_timeout;
+	}
+
+	unsigned long long timeout_timer = 0;
+	if (timeout.count() > 0)
+	{
+		tool_request.deadline = std::chrono::steady_clock::now() + timeout;
+		timeout_timer = m_executor.RunAfter(timeout, [this, tool_request]
+		{
+			ExpireRequest(tool_request);
+		});
+	}
+
+	McpToolCallback callback = tool_info_ptr->callback;
+
+	bool is_waiter = false;
+	if (!cache_key.empty())
+	{
+		std::lock_guard<std::mutex> lock(m_flight_mutex);
+
+		auto it = m_flights.find(cache_key);
+		if (it != m_flights.end())
+		{
+			it->second.waiters.emplace_back(tool_request);
+			is_waiter = true;
+		}
+		else
+		{
+			McpFlight& flight = m_flights[cache_key];
+			flight.callback = callback;
+			flight.arguments = arguments;
+		}
+	}
+
+	bool is_pending = false;
+	{
+		std::lock_guard<std::mutex> lock(m_request_mutex);
+
+		auto it = m_requests.find(McpRequestKey(request.session_id, request.id));
+		if (it != m_requests.end() && it->second.request.cancellation == request.cancellation)
+		{
+			McpRequestInfo& request_info = it->second;
+			request_info.request.progress_token = tool_request.progress_token;
+			request_info.request.deadline = tool_request.deadline;
+			request_info.tool = tool_info_ptr;
+			request_info.timeout_timer = timeout_timer;
+			if (!is_waiter)
+			{
+				request_info.cache_key = std::move(cache_key);
+			}
+
+			// Progress state lives as long as the call. A token an earlier call used starts over here.
+			if (!tool_request.progress_token.empty())
+			{
+				std::lock_guard<std::mutex> lock2(m_progress_mutex);
+
+				McpProgressInfo progress_info;
+				progress_info.request = tool_request;
+				m_progress[McpRequestKey(request.session_id, tool_request.progress_token)] = std::move(progress_info);
+			}
+			is_pending = true;
+		}
+	}
+	if (!is_pending && timeout_timer != 0)
+	{
+		m_executor.CancelTimer(timeout_timer);
+	}
+
+	if (!is_waiter)
+	{
+		RunTool(tool_request, callback, std::move(arguments));
+	}
+}
+
+void McpServerImpl::RunTool(const McpRequest& request, McpToolCallback callback, McpArguments arguments)
+{
+	m_scheduler.Post(request.session_id, [this, callback, request, arguments = std::move(arguments)]
+	{
+		if (request.cancellation.IsCancelled())
+		{
+			return;
+		}
+
+		try
+		{
+			callback(request, arguments);
+		}
+		catch (const std::exception& e)
+		{
+			MCP_LOG_ERROR("tool callback failed: %s", e.what());
+			SendError(request, -32603, "Internal error");
+		}
+	});
+}
+
+std::deque<McpRequest> McpServerImpl::FinishFlight(const std::string& cache_key)
+{
+	std::lock_guard<std::mutex> lock(m_flight_mutex);
+
+	std::deque<McpRequest> waiters;
+	auto it = m_flights.find(cache_key);
+	if (it != m_flights.end())
+	{
+		waiters.swap(it->second.waiters);
+		m_flights.erase(it);
+	}
+
+	return waiters;
+}
+
+// The call running the tool went away before answering, so a waiting call takes over.
+void McpServerImpl::AbandonFlight(const std::string& cache_key)
+{
+	std::lock_guard<std::mutex> lock(m_flight_mutex);
+
+	auto it = m_flights.find(cache_key);
+	if (it == m_flights.end())
+	{
+		return;
+	}
+
+	McpFlight& flight = it->second;
+	while (!flight.waiters.empty())
+	{
+		McpRequest request = flight.waiters.front();
+		flight.waiters.pop_front();
+
+		{
+			std::lock_guard<std::mutex> lock2(m_request_mutex);
+
+			auto it2 = m_requests.find(McpRequestKey(request.session_id, request.id));
+			if (it2 == m_requests.end() || it2->second.request.cancellation != request.cancellation)
+			{
+				continue;
+			}
+			it2->second.cache_key = cache_key;
+		}
+
+		RunTool(request, flight.callback, flight.arguments);
+		return;
+	}
+
+	m_flights.erase(it);
+}
+
+void McpServerImpl::OnCancelled(const McpRequest& request, const std::shared_ptr<const std::string>& /* buffer */, const McpJsonToken& params)
+{
+	// Request ids are keyed by their raw JSON text, which requestId repeats.
+	McpJsonReader::ForEachMember(params, [&](const McpJsonToken& key, const McpJsonToken& value)
+	{
+		if (McpJsonReader::GetStringContent(key) == "requestId")
+		{
+			CancelRequest(McpRequestKey(request.session_id, std::string(value.raw)));
+			return false;
+		}
+		return true;
+	});
+}
+
+// The client deadline is a relative "timeout" in milliseconds under params._meta.
+void McpServerImpl::ReadMeta(const McpJsonToken& meta, std::chrono::milliseconds& timeout, std::string& progress_token)
+{
+	long long timeout_value = 0;
+
+	McpJsonReader::ForEachMember(meta, [&](const McpJsonToken& key, const McpJsonToken& value)
+	{
+		std::string_view name = McpJsonReader::GetStringContent(key);
+		if (name == "timeout" && value.type == MCP_JSON_TYPE_NUMBER)
+		{
+			std::from_chars(value.raw.data(), value.raw.data() + value.raw.size(), timeout_value);
+		}
+		else if (name == "progressToken" && (value.type == MCP_JSON_TYPE_STRING || value.type == MCP_JSON_TYPE_NUMBER))
+		{
+			progress_token = std::string(value.raw);
+		}
+		return true;
+	});
+
+	timeout = std::chrono::milliseconds(timeout_value > 0 ? timeout_value : 0);
+}
+
+// Tool name followed by the declared arguments sorted by name. Strings are compared
+// unescaped, objects and arrays after re-serializing with sorted keys. Every field is
+// length-prefixed, since unescaped strings may contain any byte.
+static void AppendCacheKeyField(std::string& cache_key, char tag, std::string_view field)
+{
+	cache_key += std::to_string(field.size());
+	cache_key += tag;
+	cache_key += field;
+}
+
+std::string McpServerImpl::CreateCacheKey(const McpToolInfo& tool_info, const McpArguments& arguments)
+{
+	std::vector<const McpArguments::McpArgument*> members;
+	for (auto it = arguments.m_arguments.begin(); it != arguments.m_arguments.end(); it++)
+	{
+		members.push_back(&*it);
+	}
+
+	std::sort(members.begin(), members.end(), [](const auto* a, const auto* b) { return a->name < b->name; });
+
+	std::string cache_key;
+	AppendCacheKeyField(cache_key, 't', tool_info.name);
+	for (auto it = members.begin(); it != members.end(); it++)
+	{
+		const McpArguments::McpArgument& argument = **it;
+		AppendCacheKeyField(cache_key, 'n', argument.name);
+
+		switch (argument.type) {
+		case MCP_PROPERTY_TYPE_STRING:
+			AppendCacheKeyField(cache_key, 's', argument.value);
+			break;
+		case MCP_PROPERTY_TYPE_INTEGER:
+			AppendCacheKeyField(cache_key, 'i', std::to_string(argument.int_value));
+			break;
+		case MCP_PROPERTY_TYPE_OBJECT:
+			AppendCacheKeyField(cache_key, 'o', nlohmann::json::parse(argument.value.begin(), argument.value.end()).dump());
+			break;
+		default:
+			AppendCacheKeyField(cache_key, 'v', argument.value);
+			break;
+		}
+	}
+
+	return cache_key;
+}
+
+void McpServerImpl::SendResponse(const McpRequest& request, const nlohmann::json& result)
+{
+	SendRawResponse(request, result.dump());
+}
+
+void McpServerImpl::SendRawResponse(const McpRequest& request, const std::string& result_str)
+{
+	if (!FinishRequest(request))
+	{
+		return;
+	}
+
+	McpJsonWriter writer;
+	writer.BeginResult(request.id);
+	writer.AppendRaw(result_str);
+	writer.End();
+
+	DeliverResponse(request, writer.GetString());
+}
+
+void McpServerImpl::SendError(const McpRequest& request, int code, const std::string& message)
+{
+	McpRequestInfo request_info;
+	if (!request.id.empty() && !FinishRequest(request, &request_info))
+	{
+		return;
+	}
+
+	DeliverError(request, code, message);
+
+	if (!request_info.cache_key.empty())
+	{
+		std::deque<McpRequest> waiters = FinishFlight(request_info.cache_key);
+		for (auto it = waiters.begin(); it != waiters.end(); it++)
+		{
+			SendError(*it, code, message);
+		}
+	}
+}
+
+void McpServerImpl::DeliverError(const McpRequest& request, int code, const std::string& message)
+{
+	McpJsonWriter writer;
+	writer.BeginError(request.id);
+	writer.AppendRaw("{\"code\":");
+	writer.AppendInt(code);
+	writer.AppendRaw(",\"message\":");
+	writer.AppendString(message);
+	writer.AppendRaw("}");
+	writer.End();
+
+	DeliverResponse(request, writer.GetString());
+}
+
+void McpServerImpl::SendToolNotification(const McpRequest& request, const std::string& method, const nlohmann::json& params)
+{
+	if (request.cancellation.IsCancelled())
+	{
+		return;
+	}
+
+	McpJsonWriter writer;
+	writer.BeginNotification("notifications/" + method);
+	writer.AppendRaw(params.dump());
+	writer.End();
+
+	m_transport->SendResponse(request.session_id, request.stream_id, writer.GetString(), false);
+}
+
+void McpServerImpl::SendLogMessage(const McpRequest& request, McpLogLevel level, const std::string& logger, const nlohmann::json& data)
+{
+	if (request.cancellation.IsCancelled())
+	{
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(m_log_level_mutex);
+
+		auto it = m_session_log_levels.find(request.session_id);
+		if (level < (it != m_session_log_levels.end() ? it->second : MCP_LOG_LEVEL_INFO))
+		{
+			return;
+		}
+	}
+
+	McpJsonWriter writer;
+	writer.BeginNotification("notifications/message");
+	writer.AppendRaw("{\"level\":");
+	writer.AppendString(McpLogLevelToString(level));
+	if (!logger.empty())
+	{
+		writer.AppendRaw(",\"logger\":");
+		writer.AppendString(logger);
+	}
+	writer.AppendRaw(",\"data\":");
+	writer.AppendRaw(data.dump());
+	writer.AppendRaw("}");
+	writer.End();
+
+	m_transport->SendResponse(request.session_id, request.stream_id, writer.GetString(), false);
+}
+
+void McpServerImpl::SetProgressInterval(std::chrono::milliseconds interval)
+{
+	std::lock_guard<std::mutex> lock(m_progress_mutex);
+
+	m_progress_interval = interval;
+}
+
+void McpServerImpl::SendProgress(const McpRequest& request, double progress, double total, const std::string& message)
+{
+	if (request.progress_token.empty() || request.cancellation.IsCancelled())
+	{
+		return;
+	}
+
+	McpJsonWriter writer;
+	writer.BeginNotification("notifications/progress");
+	writer.AppendRaw("{\"progressToken\":");
+	writer.AppendRaw(request.progress_token);
+	writer.AppendRaw(",\"progress\":");
+	writer.AppendDouble(progress);
+	if (total > 0)
+	{
+		writer.AppendRaw(",\"total\":");
+		writer.AppendDouble(total);
+	}
+	if (!message.empty())
+	{
+		writer.AppendRaw(",\"message\":");
+		writer.AppendString(message);
+	}
+	writer.AppendRaw("}");
+	writer.End();
+
+	McpRequestKey progress_key(request.session_id, request.progress_token);
+	std::shared_ptr<std::mutex> send_mutex = FindProgressSendMutex(progress_key);
+	if (!send_mutex)
+	{
+		return;
+	}
+
+	// Updates of one call are decided and written one at a time, and EndProgress waits for
+	// the one being written, so none can follow the final response.
+	std::lock_guard<std::mutex> send_lock(*send_mutex);
+	auto now = std::chrono::steady_clock::now();
+	{
+		std::lock_guard<std::mutex> lock(m_progress_mutex);
+
+		// The entry is gone once the call has finished, and a later call may have taken over the token.
+		auto it = m_progress.find(progress_key);
+		if (it == m_progress.end() || it->second.request.cancellation != request.cancellation)
+		{
+			return;
+		}
+		McpProgressInfo& progress_info = it->second;
+
+		if (progress_info.is_scheduled || now - progress_info.last_sent < m_progress_interval)
+		{
+			progress_info.pending_str = writer.GetString();
+			if (!progress_info.is_scheduled)
+			{
+				progress_info.is_scheduled = true;
+				auto delay = std::chrono::duration_cast<std::chrono::milliseconds>(progress_info.last_sent + m_progress_interval - now);
+				m_executor.RunAfter(delay, [this, progress_key, cancellation = request.cancellation]
+				{
+					FlushProgress(progress_key, cancellation);
+				});
+			}
+			return;
+		}
+
+		progress_info.last_sent = now;
+	}
+
+	m_transport->SendResponse(request.session_id, request.stream_id, writer.GetString(), false);
+}
+
+std::shared_ptr<std::mutex> McpServerImpl::FindProgressSendMutex(const McpRequestKey& progress_key)
+{
+	std::lock_guard<std::mutex> lock(m_progress_mutex);
+
+	auto it = m_progress.find(progress_key);
+	if (it == m_progress.end())
+	{
+		return nullptr;
+	}
+	return it->second.send_mutex;
+}
+
+void McpServerImpl::FlushProgress(const McpRequestKey& progress_key, const McpCancellationToken& cancellation)
+{
+	std::shared_ptr<std::mutex> send_mutex = FindProgressSendMutex(progress_key);
+	if (!send_mutex)
+	{
+		return;
+	}
+
+	std::lock_guard<std::mutex> send_lock(*send_mutex);
+
+	McpRequest request;
+	std::string pending_str;
+	{
+		std::lock_guard<std::mutex> lock(m_progress_mutex);
+
+		// Nothing is left to send once the call has finished.
+		auto it = m_progress.find(progress_key);
+		if (it == m_progress.end() || it->second.request.cancellation != cancellation)
+		{
+			return;
+		}
+
+		McpProgressInfo& progress_info = it->second;
+		progress_info.is_scheduled = false;
+		progress_info.last_sent = std::chrono::steady_clock::now();
+		pending_str.swap(progress_info.pending_str);
+		request = progress_info.request;
+	}
+
+	m_transport->SendResponse(request.session_id, request.stream_id, pending_str, false);
+}
+
+void McpServerImpl::EndProgress(const McpRequest& request)
+{
+	if (request.progress_token.empty())
+	{
+		return;
+	}
+
+	std::shared_ptr<std::mutex> send_mutex;
+	{
+		std::lock_guard<std::mutex> lock(m_progress_mutex);
+
+		auto it = m_progress.find(McpRequestKey(request.session_id, request.progress_token));
+		if (it == m_progress.end() || it->second.request.cancellation != request.cancellation)
+		{
+			return;
+		}
+
+		send_mutex = it->second.send_mutex;
+		m_progress.erase(it);
+	}
+
+	// Waits out an update being written, so the final response goes after it.
+	std::lock_guard<std::mutex> lock(*send_mutex);
+}
+
+void McpServerImpl::SendToolResponse(const McpRequest& request, std::vector<McpContent> contents)
+{
+	McpRequestInfo request_info;
+	if (!FinishRequest(request, &request_info))
+	{
+		return;
+	}
+
+	// Requests that are not tool calls, such as RegisterMethod handlers, get plain text content.
+	const McpToolInfo* tool_info = request_info.tool.get();
+
+	McpJsonWriter writer;
+	writer.BeginResult(request.id);
+	size_t result_offset = writer.GetString().size();
+
+	if (tool_info == nullptr || tool_info->output_schema.size() == 0)
+	{
+		writer.AppendRaw("{\"content\":[");
+		for (auto it = contents.begin(); it != contents.end(); it++)
+		{
+			if (it != contents.begin())
+			{
+				writer.AppendRaw(",");
+			}
+			writer.AppendRaw("{\"type\":\"text\",\"text\":");
+			writer.AppendString(it->properties.size() > 0 ? it->properties[0].value : "");
+			writer.AppendRaw("}");
+		}
+		writer.AppendRaw("]}");
+	}
+	else
+	{
+		// Each row is rendered once; the text content carries it as an escaped
+		// string and structuredContent carries it verbatim.
+		std::string row_str;
+		std::string structured_str = "{\"content\":[";
+
+		writer.AppendRaw("{\"content\":[");
+		for (auto it = contents.begin(); it != contents.end(); it++)
+		{
+			row_str = "{";
+			bool is_first = true;
+			for (auto it2 = it->properties.begin(); it2 != it->properties.end(); it2++)
+			{
+				auto it3 = tool_info->output_schema.find(it2->name);
+				if (it3 == tool_info->output_schema.end())
+				{
+					continue;
+				}
+
+				if (!is_first)
+				{
+					row_str += ",";
+				}
+				is_first = false;
+
+				row_str += "\"";
+				McpJsonWriter::AppendEscaped(row_str, it2->name);
+				row_str += "\":";
+				AppendPropertyValue(row_str, it3->second, it2->value);
+			}
+			row_str += "}";
+
+			if (it != contents.begin())
+			{
+				writer.AppendRaw(",");
+				structured_str += ",";
+			}
+			writer.AppendRaw("{\"type\":\"text\",\"text\":");
+			writer.AppendString(row_str);
+			writer.AppendRaw("}");
+			structured_str += row_str;
+		}
+		structured_str += "]}";
+
+		writer.AppendRaw("],\"structuredContent\":");
+		writer.AppendRaw(structured_str);
+		writer.AppendRaw("}");
+	}
+
+	// Calls that waited on this one get the same result under their own ids.
+	std::string result_str;
+	std::deque<McpRequest> waiters;
+	if (!request_info.cache_key.empty())
+	{
+		result_str = writer.GetString().substr(result_offset);
+		waiters = FinishFlight(request_info.cache_key);
+	}
+
+	writer.End();
+
+	DeliverResponse(request, writer.GetString());
+
+	for (auto it = waiters.begin(); it != waiters.end(); it++)
+	{
+		SendRawResponse(*it, result_str);
+	}
+
+	if (!request_info.cache_key.empty() && tool_info->cache_ttl.count() > 0)
+	{
+		m_result_cache.Put(request_info.cache_key, std::move(result_str), tool_info->cache_ttl);
+	}
+}
+
+void McpServerImpl::AppendPropertyValue(std::string& buffer, const McpProperty& property, const std::string& value)
+{
+	switch (property.type) {
 	case MCP_PROPERTY_TYPE_NUMBER:
-		return value.value;
-	case MCP_PROPERTY_TYPE_STRING:
-		if (escape)
+	case MCP_PROPERTY_TYPE_INTEGER:
+		if (McpJsonReader::IsNumber(value))
+		{
+			buffer += value;
+		}
+		else
+		{
+			buffer += "null";
+		}
+		break;
+	case MCP_PROPERTY_TYPE_OBJECT:
+		if (nlohmann::json::accept(value))
 		{
-			return "\\\"" + value.value + "\\\"";
+			buffer += value;
 		}
 		else
 		{
-			return "\"" + value.value + "\"";
+			buffer += "null";
 		}
+		break;
+	case MCP_PROPERTY_TYPE_BOOLEAN:
+		buffer += value == "true" ? "true" : "false";
+		break;
 	default:
-		return "";
+		buffer += "\"";
+		McpJsonWriter::AppendEscaped(buffer, value);
+		buffer += "\"";
+		break;
 	}
 }
 
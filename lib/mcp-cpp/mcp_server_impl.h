@@ -18,59 +18,197 @@
 #pragma once
 
 #include "mcp-cpp/mcp_server.h"
+#include "mcp_executor.h"
+#include "mcp_fair_scheduler.h"
+#include "mcp_input_validator.h"
+#include "mcp_json_reader.h"
+#include "mcp_result_cache.h"
+
+#include <unordered_map>
 
 namespace Mcp {
 
+struct McpBatch {
+	std::mutex mutex;
+	size_t pending;
+	std::vector<std::string> responses;
+};
+
 class McpServerImpl : public McpServer
 {
 public:
 	McpServerImpl(const std::string& server_name, const std::string& version);
 
-	virtual void AddTool(
-		const McpTool& tool,
-		std::function <void(const std::string& session_id, const std::map<std::string, std::string>& args)> callback
-		);
+	virtual void AddTool(const McpTool& tool, McpToolCallback callback);
+	virtual void AddAsyncTool(const McpTool& tool, McpAsyncToolCallback callback);
+
+	virtual void RegisterMethod(const std::string& method, McpMethodCallback callback);
+
+	virtual void SetToolsListPageSize(size_t page_size);
+
+	virtual void SetRequestLimits(size_t max_requests, size_t max_session_requests);
+
+	virtual void SetToolThreadCount(size_t thread_count);
+	virtual McpExecutorStats GetExecutorStats();
+
+	virtual void SetSessionWeightCallback(McpSessionWeightCallback callback);
+
+	virtual void SetCacheMemoryLimit(size_t memory_limit);
+	virtual McpCacheStats GetCacheStats();
 
 	virtual bool Run(std::unique_ptr<McpServerTransport> transport);
 	virtual void Stop();
 	virtual bool IsRunning();
 
-	virtual void SendResponse(const std::string& session_id, const nlohmann::json& response);
-	virtual void SendError(const std::string& session_id, int code, const std::string& message);
-	virtual void SendToolNotification(const std::string& session_id, const std::string& method, const nlohmann::json& params);
-	virtual void SendToolResponse(const std::string& session_id, const std::string& method, std::vector<McpContent> contents);
+	virtual void SendResponse(const McpRequest& request, const nlohmann::json& result);
+	virtual void SendError(const McpRequest& request, int code, const std::string& message);
+	virtual void SendToolNotification(const McpRequest& request, const std::string& method, const nlohmann::json& params);
+	virtual void SendProgress(const McpRequest& request, double progress, double total, const std::string& message);
+	virtual void SetProgressInterval(std::chrono::milliseconds interval);
+	virtual void SendLogMessage(const McpRequest& request, McpLogLevel level, const std::string& logger, const nlohmann::json& data);
+	virtual void SendToolResponse(const McpRequest& request, std::vector<McpContent> contents);
 
 protected:
 	virtual void OnClose(const std::string& session_id);
-	virtual bool OnRecv(const std::string& session_id, const std::string& request_str);
+	virtual bool OnRecv(const std::string& session_id, unsigned long long stream_id, std::string request_str);
+	virtual bool CanAccept(const std::string& session_id, const std::string& method);
 
 private:
 	std::string m_server_name;
 	std::string m_version;
+	std::string m_initialize_result_str;
 
 	struct McpToolInfo {
 		std::string name;
 		std::string description;
-		std::map<std::string, McpProperty> input_schema;
-		std::map<std::string, McpProperty> output_schema;
-		std::function <void(const std::string& session_id, const std::map<std::string, std::string>& args)> callback;
+		std::map<std::string, McpProperty, std::less<>> input_schema;
+		std::map<std::string, McpProperty, std::less<>> output_schema;
+		McpInputValidator input_validator;
+		McpToolCallback callback;
+		std::chrono::milliseconds timeout;
+		bool idempotent;
+		std::chrono::milliseconds cache_ttl;
+		std::string record_str;	// serialized tools/list entry
+	};
+	std::map<std::string, std::shared_ptr<McpToolInfo>, std::less<>> m_tools;
+	std::string m_tools_list_str;
+	size_t m_tools_list_page_size;
+	std::mutex m_tools_mutex;
+
+	static std::string CreateToolRecord(const McpToolInfo& tool_info);
+
+	// Handler reading params straight from the request buffer. Always runs inline.
+	typedef std::function <void(const McpRequest& request, const std::shared_ptr<const std::string>& buffer, const McpJsonToken& params)> McpRawMethodCallback;
+
+	enum McpMethodLane {
+		MCP_METHOD_LANE_CONTROL,	// inline even inside batches, exempt from request limits
+		MCP_METHOD_LANE_INLINE,	// inline on the receiving thread
+		MCP_METHOD_LANE_EXECUTOR
+	};
+
+	struct McpMethodInfo {
+		McpMethodCallback callback;
+		McpRawMethodCallback raw_callback;
+		McpMethodLane lane;
 	};
-	std::map<std::string, McpToolInfo> m_tools;
+	struct McpStringHash {
+		using is_transparent = void;
+		size_t operator()(std::string_view value) const { return std::hash<std::string_view>()(value); }
+	};
+	std::unordered_map<std::string, McpMethodInfo, McpStringHash, std::equal_to<>> m_methods;
+
+	void AddMethod(const std::string& method, McpMethodCallback callback, McpMethodLane lane);
+	void AddRawMethod(const std::string& method, McpRawMethodCallback raw_callback, McpMethodLane lane);
+	bool IsControl(std::string_view method);
+	void DispatchMethod(const McpMethodInfo& method_info, const McpRequest& request, const std::shared_ptr<const std::string>& buffer, const McpJsonToken& params);
 
 	std::unique_ptr<McpServerTransport> m_transport;
 
-	std::map<std::string, int> m_request_id;
+	struct McpRequestInfo {
+		McpRequest request;
+		std::shared_ptr<McpToolInfo> tool;
+		std::string cache_key;	// set on the call that runs the tool for an idempotent call key
+		unsigned long long timeout_timer = 0;	// m_executor timer that expires the request, if any
+	};
+	typedef std::pair<std::string, std::string> McpRequestKey;	// session id, request id
+	std::map<McpRequestKey, McpRequestInfo> m_requests;
+	std::unordered_map<std::string, size_t> m_session_request_counts;
+	size_t m_max_requests;
+	size_t m_max_session_requests;
+	std::mutex m_request_mutex;
+
+	bool ProcRequest(McpRequest& request, const std::shared_ptr<const std::string>& buffer, const McpJsonToken& request_token);
+	bool ProcBatch(McpRequest& request, const std::shared_ptr<const std::string>& buffer, const McpJsonToken& batch_token);
+	static std::string GetMethod(const McpJsonToken& request_token);
+	static bool IsNotification(std::string_view method);
+	void DeliverResponse(const McpRequest& request, const std::string& response_str);
+	void SendRawResponse(const McpRequest& request, const std::string& result_str);
+	void DeliverError(const McpRequest& request, int code, const std::string& message);
+
+	enum McpBeginResult {
+		MCP_BEGIN_OK,
+		MCP_BEGIN_DUPLICATE,
+		MCP_BEGIN_OVERLOADED
+	};
+	McpBeginResult BeginRequest(const McpRequest& request, bool is_control);
+	std::map<McpRequestKey, McpRequestInfo>::iterator EraseRequest(std::map<McpRequestKey, McpRequestInfo>::iterator it);
+	bool IsOverloaded(const std::string& session_id);
+	bool FinishRequest(const McpRequest& request, McpRequestInfo* request_info = nullptr);
+	void CancelRequest(const McpRequestKey& request_key);
+	void ExpireRequest(const McpRequest& request);
 
 	std::unique_ptr<std::thread> m_worker;
-	bool m_is_running;
+	std::atomic<bool> m_is_running;
+
+	McpExecutor m_executor;
+	McpFairScheduler m_scheduler;	// orders all work of a session (calls, resumes, batch elements) before it reaches m_executor
+	size_t m_tool_thread_count;
+
+	McpResultCache m_result_cache;
+
+	// Idempotent calls in progress, keyed like the cache. Identical calls wait for the running one.
+	struct McpFlight {
+		McpToolCallback callback;
+		McpArguments arguments;
+		std::deque<McpRequest> waiters;
+	};
+	std::unordered_map<std::string, McpFlight> m_flights;
+	std::mutex m_flight_mutex;
+
+	void RunTool(const McpRequest& request, McpToolCallback callback, McpArguments arguments);
+
+	struct McpProgressInfo {
+		McpRequest request;
+		std::chrono::steady_clock::time_point last_sent;
+		std::string pending_str;	// latest update held back by the interval
+		bool is_scheduled = false;
+		std::shared_ptr<std::mutex> send_mutex = std::make_shared<std::mutex>();	// held while an update is decided and written
+	};
+	std::map<McpRequestKey, McpProgressInfo> m_progress;	// session id, progress token; only calls in flight
+	std::chrono::milliseconds m_progress_interval;
+	std::mutex m_progress_mutex;
+
+	std::shared_ptr<std::mutex> FindProgressSendMutex(const McpRequestKey& progress_key);
+	void FlushProgress(const McpRequestKey& progress_key, const McpCancellationToken& cancellation);
+	void EndProgress(const McpRequest& request);
+
+	std::unordered_map<std::string, McpLogLevel> m_session_log_levels;	// sessions that called logging/setLevel
+	std::mutex m_log_level_mutex;
+
+	std::deque<McpRequest> FinishFlight(const std::string& cache_key);
+	void AbandonFlight(const std::string& cache_key);
+
+	void OnInitialize(const McpRequest& request, const nlohmann::json& params);
+	void OnLoggingSetLevel(const McpRequest& request, const nlohmann::json& params);
+	void OnPing(const McpRequest& request, const nlohmann::json& params);
+	void OnToolsList(const McpRequest& request, const nlohmann::json& params);
+	void OnToolCall(const McpRequest& request, const std::shared_ptr<const std::string>& buffer, const McpJsonToken& params);
+	void OnCancelled(const McpRequest& request, const std::shared_ptr<const std::string>& buffer, const McpJsonToken& params);
 
-	void OnInitialize(const std::string& session_id, const nlohmann::json& request);
-	void OnLoggingSetLevel(const std::string& session_id, const nlohmann::json& request);
-	void OnPing(const std::string& session_id, const nlohmann::json& request);
-	void OnToolsList(const std::string& session_id, const nlohmann::json& request);
-	void OnToolCall(const std::string& session_id, const nlohmann::json& request);
+	static void ReadMeta(const McpJsonToken& meta, std::chrono::milliseconds& timeout, std::string& progress_token);
+	static std::string CreateCacheKey(const McpToolInfo& tool_info, const McpArguments& arguments);
 
-	static std::string GetPropertyValue(const std::map<std::string, McpProperty>& output_schema, McpPropertyValue type, bool escape);
+	static void AppendPropertyValue(std::string& buffer, const McpProperty& property, const std::string& value);
 };
 
 }
@@ -41,6 +41,11 @@ bool McpServerTransport::Open(Handler* handler)
 	return true;
 }
 
+void McpServerTransport::Stop()
+{
+	OnStop();
+}
+
 void McpServerTransport::Close()
 {
 	OnClose();
@@ -53,9 +58,14 @@ bool McpServerTransport::ProcRequest()
 	return OnProcRequest();
 }
 
-void McpServerTransport::SendResponse(const std::string& session_id, const std::string& response_str, bool is_finish)
+void McpServerTransport::SendResponse(const std::string& session_id, unsigned long long stream_id, const std::string& response_str, bool is_finish)
+{
+	OnSendResponse(session_id, stream_id, response_str, is_finish);
+}
+
+void McpServerTransport::CancelResponse(const std::string& session_id, unsigned long long stream_id)
 {
-	OnSendResponse(session_id, response_str, is_finish);
+	OnCancelResponse(session_id, stream_id);
 }
 
 }
@@ -16,6 +16,7 @@
  */
 
 #include "mcp_stdio_server_transport_impl.h"
+#include "mcp_logger.h"
 
 #include <thread>
 #include <stdio.h>
@@ -23,6 +24,9 @@
 namespace Mcp
 {
 
+// The reader stops taking input from stdin while this many requests wait.
+static const size_t MAX_QUEUED_REQUESTS = 256;
+
 std::unique_ptr<McpStdioServerTransport> McpStdioServerTransport::CreateInstance(int max_request_size)
 {
 	return  std::make_unique<McpStdioServerTransportImpl>(max_request_size);
@@ -49,7 +53,11 @@ bool McpStdioServerTransportImpl::OnOpen()
 		{
 			if (fgets(m_request_buffer, m_max_request_size, stdin) == nullptr)
 			{
-				m_stdin_close = true;
+				MCP_LOG_INFO("stdin closed");
+				{
+					std::lock_guard<std::mutex> lock(m_request_mutex);
+					m_stdin_close = true;
+				}
 				m_request_cv.notify_one();
 				break;
 			}
@@ -58,7 +66,8 @@ bool McpStdioServerTransportImpl::OnOpen()
 			if (m_request_buffer[pos - 1] == '\n')
 			{
 				{
-					std::lock_guard<std::mutex> lock(m_request_mutex);
+					std::unique_lock<std::mutex> lock(m_request_mutex);
+					m_request_space_cv.wait(lock, [this] { return m_request_queue.size() < MAX_QUEUED_REQUESTS; });
 					m_request_queue.push(m_request_buffer);
 				}
 				m_request_cv.notify_one();
@@ -72,28 +81,29 @@ bool McpStdioServerTransportImpl::OnOpen()
 
 bool McpStdioServerTransportImpl::OnProcRequest()
 {
-	std::unique_lock<std::mutex> lock(m_request_mutex);
-	if (m_request_cv.wait_for(lock, std::chrono::milliseconds(50)) == std::cv_status::timeout)
+	std::queue<std::string> requests;
 	{
-		return true;
-	}
+		std::unique_lock<std::mutex> lock(m_request_mutex);
+		m_request_cv.wait_for(lock, std::chrono::milliseconds(50), [this] { return !m_request_queue.empty() || m_stdin_close; });
 
-	if (m_stdin_close)
-	{
-		return false;
+		if (m_request_queue.empty())
+		{
+			return !m_stdin_close;
+		}
+		requests.swap(m_request_queue);
 	}
+	m_request_space_cv.notify_one();
 
-	while (!m_request_queue.empty())
+	while (!requests.empty())
 	{
-		const std::string& request_str = m_request_queue.front();
-		m_handler->OnRecv("", request_str);
-		m_request_queue.pop();
+		m_handler->OnRecv("", 0, std::move(requests.front()));
+		requests.pop();
 	}
 
 	return true;
 }
 
-void McpStdioServerTransportImpl::OnSendResponse(const std::string& session_id, const std::string& response_str, bool is_finish)
+void McpStdioServerTransportImpl::OnSendResponse(const std::string& /* session_id */, unsigned long long /* stream_id */, const std::string& response_str, bool /* is_finish */)
 {
 	fprintf(stdout, "%s\n", response_str.c_str());
 	fflush(stdout);
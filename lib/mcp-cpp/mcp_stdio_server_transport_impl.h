@@ -35,10 +35,11 @@ private:
 	std::queue<std::string> m_request_queue;
 	std::mutex m_request_mutex;
 	std::condition_variable m_request_cv;
+	std::condition_variable m_request_space_cv;
 
 	virtual bool OnOpen();
 	virtual bool OnProcRequest();
-	virtual void OnSendResponse(const std::string& session_id, const std::string& response_str, bool is_finish);
+	virtual void OnSendResponse(const std::string& session_id, unsigned long long stream_id, const std::string& response_str, bool is_finish);
 };
 
 }
@@ -26,6 +26,7 @@ const std::vector<McpContent> CreateSimpleContent(const std::string& value)
 		{
 			{
 				{
+					.name = "",
 					.value = value
 				}
 			}
@@ -44,6 +45,10 @@ std::string McpPropertyTypeToString(McpPropertyType type)
 		return "string";
 	case MCP_PROPERTY_TYPE_OBJECT:
 		return "object";
+	case MCP_PROPERTY_TYPE_INTEGER:
+		return "integer";
+	case MCP_PROPERTY_TYPE_BOOLEAN:
+		return "boolean";
 	default:
 		return "unknown";
 	}
@@ -67,8 +72,186 @@ McpPropertyType StringToMcpPropertyType(const std::string& type)
 	{
 		return MCP_PROPERTY_TYPE_OBJECT;
 	}
+	else if (type == "integer")
+	{
+		return MCP_PROPERTY_TYPE_INTEGER;
+	}
+	else if (type == "boolean")
+	{
+		return MCP_PROPERTY_TYPE_BOOLEAN;
+	}
 
 	return MCP_PROPERTY_TYPE_UNKNOWN;
 }
 
+static const char* const LOG_LEVEL_NAMES[] = {
+	"debug", "info", "notice", "warning", "error", "critical", "alert", "emergency"
+};
+
+std::string McpLogLevelToString(McpLogLevel level)
+{
+	if (level < MCP_LOG_LEVEL_DEBUG || level > MCP_LOG_LEVEL_EMERGENCY)
+	{
+		return "unknown";
+	}
+
+	return LOG_LEVEL_NAMES[level];
+}
+
+McpLogLevel StringToMcpLogLevel(std::string_view level)
+{
+	for (int i = MCP_LOG_LEVEL_DEBUG; i <= MCP_LOG_LEVEL_EMERGENCY; i++)
+	{
+		if (level == LOG_LEVEL_NAMES[i])
+		{
+			return (McpLogLevel)i;
+		}
+	}
+
+	return MCP_LOG_LEVEL_UNKNOWN;
+}
+
+McpArguments::McpArguments()
+{
+}
+
+bool McpArguments::Has(std::string_view name) const
+{
+	return Find(name) != nullptr;
+}
+
+std::string_view McpArguments::Get(std::string_view name) const
+{
+	const McpArgument* argument = Find(name);
+	return argument != nullptr ? argument->value : std::string_view();
+}
+
+int64_t McpArguments::GetInt64(std::string_view name, int64_t default_value) const
+{
+	const McpArgument* argument = Find(name);
+	if (argument == nullptr)
+	{
+		return default_value;
+	}
+
+	switch (argument->type) {
+	case MCP_PROPERTY_TYPE_INTEGER:
+		return argument->int_value;
+	case MCP_PROPERTY_TYPE_NUMBER:
+		return (int64_t)argument->double_value;
+	default:
+		return default_value;
+	}
+}
+
+double McpArguments::GetDouble(std::string_view name, double default_value) const
+{
+	const McpArgument* argument = Find(name);
+	if (argument == nullptr)
+	{
+		return default_value;
+	}
+
+	switch (argument->type) {
+	case MCP_PROPERTY_TYPE_INTEGER:
+		return (double)argument->int_value;
+	case MCP_PROPERTY_TYPE_NUMBER:
+		return argument->double_value;
+	default:
+		return default_value;
+	}
+}
+
+bool McpArguments::GetBool(std::string_view name, bool default_value) const
+{
+	const McpArgument* argument = Find(name);
+	if (argument == nullptr || argument->type != MCP_PROPERTY_TYPE_BOOLEAN)
+	{
+		return default_value;
+	}
+
+	return argument->bool_value;
+}
+
+size_t McpArguments::Size() const
+{
+	return m_arguments.size();
+}
+
+const McpArguments::McpArgument* McpArguments::Find(std::string_view name) const
+{
+	for (auto it = m_arguments.begin(); it != m_arguments.end(); it++)
+	{
+		if (it->name == name)
+		{
+			return &*it;
+		}
+	}
+
+	return nullptr;
+}
+
+McpCancellationToken::McpCancellationToken()
+{
+}
+
+McpCancellationToken McpCancellationToken::Create()
+{
+	McpCancellationToken token;
+	token.m_state = std::make_shared<McpCancellationState>();
+	token.m_state->is_cancelled = false;
+
+	return token;
+}
+
+bool McpCancellationToken::IsCancelled() const
+{
+	return m_state && m_state->is_cancelled;
+}
+
+void McpCancellationToken::OnCancel(std::function<void()> callback) const
+{
+	if (!m_state)
+	{
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(m_state->mutex);
+
+		if (!m_state->is_cancelled)
+		{
+			m_state->callbacks.emplace_back(callback);
+			return;
+		}
+	}
+
+	callback();
+}
+
+void McpCancellationToken::Cancel() const
+{
+	if (!m_state)
+	{
+		return;
+	}
+
+	std::vector<std::function<void()>> callbacks;
+	{
+		std::lock_guard<std::mutex> lock(m_state->mutex);
+
+		if (m_state->is_cancelled)
+		{
+			return;
+		}
+		m_state->is_cancelled = true;
+		callbacks.swap(m_state->callbacks);
+	}
+
+	for (auto it = callbacks.begin(); it != callbacks.end(); it++)
+	{
+		(*it)();
+	}
+}
+
 }
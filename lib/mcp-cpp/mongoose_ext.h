@@ -0,0 +1,159 @@
+/*
+ *  Copyright (C) 2025 UmeSoftware LLC
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+// Extensions to mongoose that need its internals: static functions and structures that are
+// private to mongoose.c rather than declared in mongoose.h. Include this only right after
+// mongoose.c, and check every function here against the new source whenever mongoose is
+// updated. Nothing outside this file may use those internals.
+
+#pragma once
+
+#ifndef MONGOOSE_H
+#error "include mongoose.c before mongoose_ext.h"
+#endif
+
+// Like mg_listen(), but takes an already listening socket, such as one handed over by
+// another process.
+static struct mg_connection* mg_ext_adopt_listener(struct mg_mgr* mgr, MG_SOCKET_TYPE fd, const char* url, mg_event_handler_t fn, void* fn_data)
+{
+	struct mg_connection* conn = mg_alloc_conn(mgr);
+	if (conn == nullptr)
+	{
+		closesocket(fd);
+		return nullptr;
+	}
+
+	setlocaddr(fd, &conn->loc);
+	mg_set_non_blocking_mode(fd);
+	conn->fd = S2PTR(fd);
+	MG_EPOLL_ADD(conn);
+	conn->is_listening = 1;
+	conn->is_tls = mg_url_is_ssl(url) != 0;
+	LIST_ADD_HEAD(struct mg_connection, &mgr->conns, conn);
+	conn->fn = fn;
+	conn->fn_data = fn_data;
+	conn->pfn = http_cb;
+	mg_call(conn, MG_EV_OPEN, nullptr);
+
+	return conn;
+}
+
+// Like mg_http_listen(), but with SO_REUSEPORT set, so that several managers can each
+// have their own socket on the same address.
+static struct mg_connection* mg_ext_http_listen_reuseport(struct mg_mgr* mgr, const char* url, mg_event_handler_t fn, void* fn_data)
+{
+#ifdef SO_REUSEPORT
+	struct mg_addr addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.port = mg_htons(mg_url_port(url));
+	if (!mg_aton(mg_url_host(url), &addr))
+	{
+		return nullptr;
+	}
+
+	union usa usa;
+	socklen_t slen = tousa(&addr, &usa);
+	MG_SOCKET_TYPE fd = socket(addr.is_ip6 ? AF_INET6 : AF_INET, SOCK_STREAM, IPPROTO_TCP);
+	if (fd == MG_INVALID_SOCKET)
+	{
+		return nullptr;
+	}
+
+	int on = 1;
+	if (setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, (char*)&on, sizeof(on)) != 0 ||
+		setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, (char*)&on, sizeof(on)) != 0 ||
+		bind(fd, &usa.sa, slen) != 0 ||
+		listen(fd, MG_SOCK_LISTEN_BACKLOG_SIZE) != 0)
+	{
+		closesocket(fd);
+		return nullptr;
+	}
+
+	return mg_ext_adopt_listener(mgr, fd, url, fn, fn_data);
+#else
+	return nullptr;
+#endif
+}
+
+// Like mg_wakeup_init(), but the read end gets its own handler, and the write end is
+// returned instead of being kept in the manager.
+static MG_SOCKET_TYPE mg_ext_wakeup_init(struct mg_mgr* mgr, mg_event_handler_t fn, void* fn_data)
+{
+	union usa usa[2];
+	MG_SOCKET_TYPE sp[2] = { MG_INVALID_SOCKET, MG_INVALID_SOCKET };
+	if (!mg_socketpair(sp, usa))
+	{
+		return MG_INVALID_SOCKET;
+	}
+
+	if (mg_wrapfd(mgr, (int)sp[1], fn, fn_data) == nullptr)
+	{
+		closesocket(sp[0]);
+		closesocket(sp[1]);
+		return MG_INVALID_SOCKET;
+	}
+
+	return sp[0];
+}
+
+#if MG_TLS == MG_TLS_OPENSSL
+// Like mg_tls_init() for an accepted connection, but on a context shared by all of them
+// instead of one parsed from the certificate again for each. Takes its own reference to
+// |ctx|, which mg_tls_free() releases.
+static bool mg_ext_tls_accept(struct mg_connection* conn, SSL_CTX* ctx)
+{
+	static BIO_METHOD* bio_method = []
+	{
+		BIO_METHOD* method = BIO_meth_new(BIO_get_new_index() | BIO_TYPE_SOURCE_SINK, "bio_mg");
+		if (method != nullptr)
+		{
+			BIO_meth_set_write(method, mg_bio_write);
+			BIO_meth_set_read(method, mg_bio_read);
+			BIO_meth_set_ctrl(method, mg_bio_ctrl);
+		}
+		return method;
+	}();
+
+	if (bio_method == nullptr || SSL_CTX_up_ref(ctx) != 1)
+	{
+		return false;
+	}
+
+	struct mg_tls* tls = (struct mg_tls*)mg_calloc(1, sizeof(*tls));
+	if (tls == nullptr)
+	{
+		SSL_CTX_free(ctx);
+		return false;
+	}
+	tls->ctx = ctx;
+	conn->tls = tls;	// bm stays null, mg_tls_free() must not free the shared method
+
+	tls->ssl = SSL_new(ctx);
+	BIO* bio = tls->ssl != nullptr ? BIO_new(bio_method) : nullptr;
+	if (bio == nullptr)
+	{
+		mg_tls_free(conn);
+		return false;
+	}
+	BIO_set_data(bio, conn);
+	SSL_set_bio(tls->ssl, bio, bio);
+
+	conn->is_tls = 1;
+	conn->is_tls_hs = 1;
+	return true;
+}
+#endif
@@ -23,5 +23,13 @@
 #endif
 
 #include <string>
+#include <vector>
 
 std::string CreateSessionId();
+
+// Handover of listening sockets to a restarted process over a Unix domain socket at |path|.
+// Not supported on Windows, where these always fail.
+int ListenHandover(const std::string& path);
+bool SendHandover(int handover_fd, const std::vector<int>& socket_fds, const std::string& state);	// false if nobody is waiting
+bool ReceiveHandover(const std::string& path, std::vector<int>& socket_fds, std::string& state);	// false if no process offers sockets
+void CloseHandover(int handover_fd, const std::string& path);	// empty |path| leaves the file in place
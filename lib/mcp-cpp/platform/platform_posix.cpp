@@ -18,6 +18,13 @@
 #include "platform.h"
 #include <uuid/uuid.h>
 
+#include <fcntl.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
 std::string CreateSessionId()
 {
 	uuid_t uuid;
@@ -25,4 +32,210 @@ std::string CreateSessionId()
 	char strUuid[37];
 	uuid_unparse(uuid, strUuid);
 	return std::string(strUuid);
-}
\ No newline at end of file
+}
+
+static const size_t MAX_HANDOVER_SOCKETS = 64;
+
+static bool FillHandoverAddress(const std::string& path, sockaddr_un& address)
+{
+	if (path.size() >= sizeof(address.sun_path))
+	{
+		return false;
+	}
+
+	memset(&address, 0, sizeof(address));
+	address.sun_family = AF_UNIX;
+	memcpy(address.sun_path, path.c_str(), path.size());
+	return true;
+}
+
+// Both ends hand over live sockets, so each accepts only a process of its own user.
+static bool IsSameUser(int fd)
+{
+#ifdef SO_PEERCRED
+	ucred credentials;
+	socklen_t length = sizeof(credentials);
+	if (getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &credentials, &length) != 0)
+	{
+		return false;
+	}
+	uid_t uid = credentials.uid;
+#else
+	uid_t uid;
+	gid_t gid;
+	if (getpeereid(fd, &uid, &gid) != 0)
+	{
+		return false;
+	}
+#endif
+	return uid == geteuid();
+}
+
+int ListenHandover(const std::string& path)
+{
+	sockaddr_un address;
+	if (!FillHandoverAddress(path, address))
+	{
+		return -1;
+	}
+
+	int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (fd < 0)
+	{
+		return -1;
+	}
+
+	// Nobody can connect before listen(), so the mode is in place for the first connection.
+	unlink(path.c_str());
+	if (bind(fd, (sockaddr*)&address, sizeof(address)) != 0 || chmod(path.c_str(), S_IRUSR | S_IWUSR) != 0 || listen(fd, 1) != 0)
+	{
+		close(fd);
+		return -1;
+	}
+
+	fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+	fcntl(fd, F_SETFD, FD_CLOEXEC);
+	return fd;
+}
+
+bool SendHandover(int handover_fd, const std::vector<int>& socket_fds, const std::string& state)
+{
+	if (socket_fds.empty() || socket_fds.size() > MAX_HANDOVER_SOCKETS)
+	{
+		return false;
+	}
+
+	int fd = accept(handover_fd, nullptr, nullptr);
+	if (fd < 0)
+	{
+		return false;
+	}
+	if (!IsSameUser(fd))
+	{
+		close(fd);
+		return false;
+	}
+
+	fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) & ~O_NONBLOCK);
+
+	// The sockets travel with the first byte; the state follows as a plain stream.
+	char tag = 'S';
+	iovec iov = { &tag, 1 };
+	char control[CMSG_SPACE(sizeof(int) * MAX_HANDOVER_SOCKETS)];
+	memset(control, 0, sizeof(control));
+
+	msghdr message;
+	memset(&message, 0, sizeof(message));
+	message.msg_iov = &iov;
+	message.msg_iovlen = 1;
+	message.msg_control = control;
+	message.msg_controllen = CMSG_SPACE(sizeof(int) * socket_fds.size());
+
+	cmsghdr* header = CMSG_FIRSTHDR(&message);
+	header->cmsg_level = SOL_SOCKET;
+	header->cmsg_type = SCM_RIGHTS;
+	header->cmsg_len = CMSG_LEN(sizeof(int) * socket_fds.size());
+	memcpy(CMSG_DATA(header), socket_fds.data(), sizeof(int) * socket_fds.size());
+
+	bool is_sent = sendmsg(fd, &message, MSG_NOSIGNAL) == 1;
+
+	size_t offset = 0;
+	while (is_sent && offset < state.size())
+	{
+		ssize_t n = send(fd, state.data() + offset, state.size() - offset, MSG_NOSIGNAL);
+		if (n <= 0)
+		{
+			is_sent = false;
+			break;
+		}
+		offset += n;
+	}
+
+	close(fd);
+	return is_sent;
+}
+
+bool ReceiveHandover(const std::string& path, std::vector<int>& socket_fds, std::string& state)
+{
+	sockaddr_un address;
+	if (!FillHandoverAddress(path, address))
+	{
+		return false;
+	}
+
+	int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (fd < 0)
+	{
+		return false;
+	}
+
+	if (connect(fd, (sockaddr*)&address, sizeof(address)) != 0 || !IsSameUser(fd))
+	{
+		close(fd);
+		return false;
+	}
+
+	// The old process answers from its event loop; do not wait forever if it is stuck.
+	timeval timeout = { 5, 0 };
+	setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+	char tag = 0;
+	iovec iov = { &tag, 1 };
+	char control[CMSG_SPACE(sizeof(int) * MAX_HANDOVER_SOCKETS)];
+
+	msghdr message;
+	memset(&message, 0, sizeof(message));
+	message.msg_iov = &iov;
+	message.msg_iovlen = 1;
+	message.msg_control = control;
+	message.msg_controllen = sizeof(control);
+
+	socket_fds.clear();
+	if (recvmsg(fd, &message, MSG_CMSG_CLOEXEC) == 1)
+	{
+		for (cmsghdr* header = CMSG_FIRSTHDR(&message); header != nullptr; header = CMSG_NXTHDR(&message, header))
+		{
+			if (header->cmsg_level == SOL_SOCKET && header->cmsg_type == SCM_RIGHTS)
+			{
+				size_t count = (header->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+				size_t offset = socket_fds.size();
+				socket_fds.resize(offset + count);
+				memcpy(socket_fds.data() + offset, CMSG_DATA(header), sizeof(int) * count);
+			}
+		}
+
+		// Some sockets did not fit and are gone; listening afresh beats serving a partial set.
+		if (message.msg_flags & MSG_CTRUNC)
+		{
+			for (auto it = socket_fds.begin(); it != socket_fds.end(); it++)
+			{
+				close(*it);
+			}
+			socket_fds.clear();
+		}
+	}
+
+	char buffer[4096];
+	ssize_t n;
+	while (!socket_fds.empty() && (n = recv(fd, buffer, sizeof(buffer), 0)) > 0)
+	{
+		state.append(buffer, n);
+	}
+
+	close(fd);
+	return !socket_fds.empty();
+}
+
+void CloseHandover(int handover_fd, const std::string& path)
+{
+	if (handover_fd < 0)
+	{
+		return;
+	}
+
+	close(handover_fd);
+	if (!path.empty())
+	{
+		unlink(path.c_str());
+	}
+}
@@ -39,4 +39,23 @@ std::string CreateSessionId()
 	RpcStringFreeA(&strUuid);
 
 	return session_id;
-}
\ No newline at end of file
+}
+
+int ListenHandover(const std::string& path)
+{
+	return -1;
+}
+
+bool SendHandover(int handover_fd, const std::vector<int>& socket_fds, const std::string& state)
+{
+	return false;
+}
+
+bool ReceiveHandover(const std::string& path, std::vector<int>& socket_fds, std::string& state)
+{
+	return false;
+}
+
+void CloseHandover(int handover_fd, const std::string& path)
+{
+}